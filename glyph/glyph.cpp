@@ -1,288 +1,1219 @@
 ﻿#include "glyph.h"
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <vector>
-#include <map>
-#include <stdexcept>
-#include <cctype>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#if defined(__linux__)
+#define GLYPH_EPOLL
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#endif
+#endif
 
 // ============================================================================
-// AST Node Types
+// Batch Mode
 // ============================================================================
 
-enum class NodeType {
-    VALUE,      // The underscore literal _
-    BINARY_OP,  // +, -, *, ^, %
-    LET,        // : binding
-    COND,       // % conditional
-    VAR         // Variable reference
-};
+// Output is written in chunks of roughly this size
+static constexpr size_t BATCH_FLUSH_BYTES = 64 * 1024;
+
+// Appends msg with control characters escaped, keeping each result on one line
+static void appendEscaped(std::string& out, const char* msg) {
+    static const char hex[] = "0123456789abcdef";
+    for (const char* p = msg; *p != '\0'; p++) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '\\') {
+            out += "\\\\";
+        }
+        else if (c < 0x20 || c == 0x7f) {
+            out += "\\x";
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+        }
+        else {
+            out += static_cast<char>(c);
+        }
+    }
+}
+
+// Programs handed to the pool per task, and read ahead per window
+static constexpr size_t BATCH_CHUNK = 16;
+static constexpr size_t BATCH_WINDOW = 64 * 1024;
+
+// Read-only mapping of a whole file, so a corpus can be sliced into programs
+// without reading or copying it
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
 
-class ASTNode {
 public:
-    NodeType type;
-    virtual ~ASTNode() = default;
-    virtual int evaluate(std::map<int, int>& env) const = 0;
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data != nullptr) UnmapViewOfFile(data);
+        if (mapping != nullptr) CloseHandle(mapping);
+#else
+        if (data != nullptr) munmap(const_cast<char*>(data), size);
+#endif
+    }
+
+    // False if the file cannot be mapped (missing, or not a regular file)
+    bool open(const char* path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER length;
+        bool ok = GetFileSizeEx(file, &length) != 0;
+        size = ok ? static_cast<size_t>(length.QuadPart) : 0;
+        if (ok && size > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            ok = data != nullptr;
+        }
+        CloseHandle(file);
+        return ok;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+        size = ok ? static_cast<size_t>(st.st_size) : 0;
+        if (ok && size > 0) {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = p != MAP_FAILED;
+            if (ok) {
+                data = static_cast<const char*>(p);
+                madvise(p, size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    std::string_view view() const {
+        return std::string_view(data, size);
+    }
 };
 
-// Value node - represents underscore (_) which equals 1
-class ValueNode : public ASTNode {
+// Newline-delimited batch input. Views returned by next() stay valid until
+// the next release(); a trailing '\r' is stripped.
+class LineSource {
 public:
-    ValueNode() { type = NodeType::VALUE; }
-    int evaluate(std::map<int, int>& env) const override {
-        return 1;
-    }
+    virtual ~LineSource() = default;
+    virtual bool next(std::string_view& line) = 0;
+    virtual void release() {}
 };
 
-// Variable node - represents a bound name (by index)
-class VarNode : public ASTNode {
+// Lines of a mapped file, handed out in place without copying
+class MappedLineSource : public LineSource {
+private:
+    std::string_view rest;
+
 public:
-    int varIndex;
-    VarNode(int idx) : varIndex(idx) { type = NodeType::VAR; }
-    int evaluate(std::map<int, int>& env) const override {
-        if (env.find(varIndex) == env.end()) {
-            throw std::runtime_error("Unbound variable: " + std::to_string(varIndex));
+    explicit MappedLineSource(std::string_view text) : rest(text) {}
+
+    bool next(std::string_view& line) override {
+        if (rest.empty()) {
+            return false;
         }
-        return env[varIndex];
+        size_t end = rest.find('\n');
+        line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return true;
     }
 };
 
-// Binary operation node
-class BinaryOpNode : public ASTNode {
+// Lines of a stream (stdin, pipes), read into buffers that are reused after
+// every release()
+class StreamLineSource : public LineSource {
+private:
+    std::istream& in;
+    std::deque<std::string> buffers; // deque: growing never moves a buffer
+    size_t used = 0;
+
 public:
-    char op;
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
-
-    BinaryOpNode(char operation, std::unique_ptr<ASTNode> l, std::unique_ptr<ASTNode> r)
-        : op(operation), left(std::move(l)), right(std::move(r)) {
-        type = NodeType::BINARY_OP;
-    }
-
-    int evaluate(std::map<int, int>& env) const override {
-        int leftVal = left->evaluate(env);
-        int rightVal = right->evaluate(env);
-
-        switch (op) {
-        case '+': return leftVal + rightVal;
-        case '-': return leftVal - rightVal;
-        case '*': return leftVal * rightVal;
-        case '^': {
-            int result = 1;
-            for (int i = 0; i < rightVal; i++) {
-                result *= leftVal;
-            }
-            return result;
+    explicit StreamLineSource(std::istream& stream) : in(stream) {}
+
+    bool next(std::string_view& line) override {
+        if (used == buffers.size()) {
+            buffers.emplace_back();
         }
-        case '%': return leftVal % rightVal;
-        default:
-            throw std::runtime_error("Unknown operator");
+        std::string& buffer = buffers[used];
+        if (!std::getline(in, buffer)) {
+            return false;
         }
+        used++;
+        line = buffer;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return true;
     }
-};
 
-// Let binding node: :(name)(value)(body)
-class LetNode : public ASTNode {
-public:
-    std::unique_ptr<ASTNode> name;
-    std::unique_ptr<ASTNode> value;
-    std::unique_ptr<ASTNode> body;
+    void release() override {
+        used = 0;
+    }
+};
 
-    LetNode(std::unique_ptr<ASTNode> n, std::unique_ptr<ASTNode> v, std::unique_ptr<ASTNode> b)
-        : name(std::move(n)), value(std::move(v)), body(std::move(b)) {
-        type = NodeType::LET;
+// Appends the result line for one program: "ok<TAB>value" or "error<TAB>message"
+static void appendResult(std::string& out, GlyphInterpreter& interpreter,
+    std::string_view program, NumericBackend backend) {
+    try {
+        std::string result = interpreter.runAs(program, backend);
+        out += "ok\t";
+        out += result;
+    }
+    catch (const std::exception& e) {
+        out += "error\t";
+        appendEscaped(out, e.what());
     }
+    out += '\n';
+}
 
-    int evaluate(std::map<int, int>& env) const override {
-        // Evaluate the bound value
-        int val = value->evaluate(env);
+// Cost-based scheduling (--numeric auto, --max-cost). Each program's cost is
+// estimated before it runs (GlyphInterpreter::estimate): one whose estimate
+// exceeds maxCost is rejected unevaluated, auto evaluates with int64 when
+// every value provably fits and with bigint otherwise (so results are
+// bigint's either way), and a parallel batch starts its most expensive
+// programs first.
+struct CostPolicy {
+    bool autoBackend = false;
+    uint64_t maxCost = 0; // 0 = no limit
 
-        // Create new environment with binding
-        std::map<int, int> newEnv = env;
-        int varIndex = name->evaluate(env); // Use evaluated name as index
-        newEnv[varIndex] = val;
+    bool enabled() const { return autoBackend || maxCost != 0; }
+};
 
-        // Evaluate body in new environment
-        return body->evaluate(newEnv);
-    }
+// A program's estimate; invalid programs have none and fail when evaluated
+struct CostPlan {
+    bool estimated = false;
+    CostEstimate cost;
 };
 
-// Conditional node: %(condition)(then)(else)
-class CondNode : public ASTNode {
-public:
-    std::unique_ptr<ASTNode> condition;
-    std::unique_ptr<ASTNode> thenBranch;
-    std::unique_ptr<ASTNode> elseBranch;
+static CostPlan planCost(GlyphInterpreter& interpreter, std::string_view program) {
+    CostPlan plan;
+    try {
+        plan.cost = interpreter.estimate(program);
+        plan.estimated = true;
+    }
+    catch (const std::exception&) {
+    }
+    return plan;
+}
 
-    CondNode(std::unique_ptr<ASTNode> c, std::unique_ptr<ASTNode> t, std::unique_ptr<ASTNode> e)
-        : condition(std::move(c)), thenBranch(std::move(t)), elseBranch(std::move(e)) {
-        type = NodeType::COND;
+static NumericBackend plannedBackend(const CostPlan& plan, const CostPolicy& policy, NumericBackend backend) {
+    if (policy.autoBackend) {
+        return plan.estimated && plan.cost.fitsInt64() ? NumericBackend::INT64 : NumericBackend::BIGINT;
     }
+    return backend;
+}
 
-    int evaluate(std::map<int, int>& env) const override {
-        int condVal = condition->evaluate(env);
+// appendResult under policy, for a program estimated as plan
+static void appendPlanned(std::string& out, GlyphInterpreter& interpreter, std::string_view program,
+    NumericBackend backend, const CostPolicy& policy, const CostPlan& plan) {
+    backend = plannedBackend(plan, policy, backend);
+    if (policy.maxCost != 0 && plan.estimated && plan.cost.steps(backend) > policy.maxCost) {
+        out += "error\tEstimated cost exceeds --max-cost\n";
+        return;
+    }
+    appendResult(out, interpreter, program, backend);
+}
 
-        // If condition % 1 == 0 (always true for integers), it's false -> else
-        // Otherwise -> then
-        // Better interpretation: if condVal == 0 -> else, otherwise -> then
-        if (condVal == 0) {
-            return elseBranch->evaluate(env);
+// Evaluates newline-delimited programs, writing exactly one line per input in
+// input order.
+static void runBatch(GlyphInterpreter& interpreter, LineSource& in, std::FILE* out, NumericBackend backend,
+    const CostPolicy& policy) {
+    std::string_view line;
+    std::string buffer;
+    buffer.reserve(BATCH_FLUSH_BYTES * 2);
+
+    while (in.next(line)) {
+        if (policy.enabled()) {
+            appendPlanned(buffer, interpreter, line, backend, policy, planCost(interpreter, line));
         }
         else {
-            return thenBranch->evaluate(env);
+            appendResult(buffer, interpreter, line, backend);
+        }
+        in.release();
+
+        if (buffer.size() >= BATCH_FLUSH_BYTES) {
+            std::fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
         }
     }
-};
+
+    std::fwrite(buffer.data(), 1, buffer.size(), out);
+    std::fflush(out);
+}
+
+// Same output as runBatch, evaluated on a work-stealing pool. Input is read a
+// window at a time; each window is split into small chunks so that a few
+// huge programs are balanced out by stealing, then written back in order.
+//
+// Under a CostPolicy the window is first estimated on the pool, and chunks
+// are formed in order of estimated cost and submitted cheapest first. Each
+// worker runs its newest task first, so the most expensive programs start
+// at once instead of being reached last and stretching the window.
+static void runBatchParallel(GlyphInterpreter& interpreter, LineSource& in, std::FILE* out,
+    NumericBackend backend, size_t jobs, const CostPolicy& policy) {
+    WorkStealingPool pool(jobs);
+    std::vector<std::string_view> programs(BATCH_WINDOW);
+    std::vector<std::string> results(BATCH_WINDOW);
+    std::vector<CostPlan> plans(policy.enabled() ? BATCH_WINDOW : 0);
+    std::vector<size_t> order;
+
+    for (;;) {
+        size_t count = 0;
+        while (count < BATCH_WINDOW && in.next(programs[count])) {
+            count++;
+        }
+
+        order.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        if (policy.enabled()) {
+            for (size_t begin = 0; begin < count; begin += BATCH_CHUNK) {
+                size_t end = std::min(begin + BATCH_CHUNK, count);
+                pool.submit([&, begin, end](size_t) {
+                    for (size_t i = begin; i < end; i++) {
+                        plans[i] = planCost(interpreter, programs[i]);
+                    }
+                });
+            }
+            pool.wait();
+            auto cost = [&](size_t i) {
+                return plans[i].cost.steps(plannedBackend(plans[i], policy, backend));
+            };
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cost(a) < cost(b); });
+        }
+
+        for (size_t begin = 0; begin < count; begin += BATCH_CHUNK) {
+            size_t end = std::min(begin + BATCH_CHUNK, count);
+            pool.submit([&, begin, end](size_t) {
+                for (size_t k = begin; k < end; k++) {
+                    size_t i = order[k];
+                    results[i].clear();
+                    if (policy.enabled()) {
+                        appendPlanned(results[i], interpreter, programs[i], backend, policy, plans[i]);
+                    }
+                    else {
+                        appendResult(results[i], interpreter, programs[i], backend);
+                    }
+                }
+            });
+        }
+        pool.wait();
+
+        for (size_t i = 0; i < count; i++) {
+            std::fwrite(results[i].data(), 1, results[i].size(), out);
+        }
+        in.release();
+        if (count < BATCH_WINDOW) {
+            break;
+        }
+    }
+
+    std::fflush(out);
+}
 
 // ============================================================================
-// Lexer / Tokenizer
+// Server Mode
 // ============================================================================
 
-class Lexer {
-private:
-    std::string input;
-    size_t pos;
+// --serve protocol. All integers are little-endian.
+//   request:  u32 program length, u64 request ID, program bytes
+//   response: u32 text length, u64 request ID, u8 status, text bytes
+// The status is SERVE_OK with the value as text, or one of the error codes
+// with the message. A client may pipeline any number of requests on one
+// connection; responses come back as they finish, not in request order.
+enum ServeStatus : uint8_t {
+    SERVE_OK = 0,
+    SERVE_ERROR = 1,
+    SERVE_STEP_LIMIT = 2,
+    SERVE_DEADLINE = 3
+};
+
+static constexpr size_t REQUEST_HEADER_BYTES = 12;
+static constexpr uint32_t MAX_REQUEST_BYTES = 64u << 20;
+
+// Requests evaluating at once per connection before reading from it pauses
+static constexpr size_t MAX_IN_FLIGHT = 1024;
+
+// Unsent response bytes per connection before reading from it pauses, so a
+// client that never reads its answers cannot grow them without bound
+static constexpr size_t MAX_PENDING_OUTPUT = 4u << 20;
+
+static constexpr size_t SERVE_READ_CHUNK = 64 * 1024;
+
+// Program cache used by --serve unless --cache says otherwise
+static constexpr size_t SERVE_DEFAULT_CACHE_MB = 64;
+
+#ifndef _WIN32
+
+static uint64_t loadLittleEndian(const char* p, size_t bytes) {
+    uint64_t v = 0;
+    for (size_t i = bytes; i-- > 0;) {
+        v = (v << 8) | static_cast<unsigned char>(p[i]);
+    }
+    return v;
+}
+
+static void appendLittleEndian(std::string& out, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out += static_cast<char>(v >> (8 * i));
+    }
+}
+
+// Evaluates one request and appends its response frame to out
+static void appendResponse(std::string& out, GlyphInterpreter& interpreter,
+    uint64_t id, std::string_view program, NumericBackend backend) {
+    std::string text;
+    ServeStatus status = SERVE_OK;
+    try {
+        text = interpreter.runAs(program, backend);
+    }
+    catch (const StepLimitExceeded& e) {
+        status = SERVE_STEP_LIMIT;
+        text = e.what();
+    }
+    catch (const DeadlineExceeded& e) {
+        status = SERVE_DEADLINE;
+        text = e.what();
+    }
+    catch (const std::exception& e) {
+        status = SERVE_ERROR;
+        text = e.what();
+    }
+    appendLittleEndian(out, text.size(), 4);
+    appendLittleEndian(out, id, 8);
+    out += static_cast<char>(status);
+    out += text;
+}
 
+// Readiness notification over epoll (Linux) or kqueue (BSD, macOS). Every
+// descriptor is registered with a 64-bit token that comes back in events.
+class EventPoller {
 public:
-    Lexer(const std::string& src) : input(src), pos(0) {}
+    struct Event {
+        uint64_t token;
+        bool readable;
+        bool hangup; // error or hangup, reported even when not watched for
+    };
+
+private:
+    int fd = -1;
 
-    char peek() const {
-        if (pos >= input.length()) return '\0';
-        return input[pos];
+public:
+    EventPoller() {
+#if defined(GLYPH_EPOLL)
+        fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+        fd = kqueue();
+#endif
+        if (fd < 0) {
+            throw std::runtime_error(std::string("Cannot create event poller: ") + std::strerror(errno));
+        }
     }
 
-    char consume() {
-        if (pos >= input.length()) return '\0';
-        return input[pos++];
+    EventPoller(const EventPoller&) = delete;
+    EventPoller& operator=(const EventPoller&) = delete;
+
+    ~EventPoller() {
+        close(fd);
     }
 
-    void expect(char c) {
-        char ch = consume();
-        if (ch != c) {
-            throw std::runtime_error(std::string("Expected '") + c + "' but got '" + ch + "'");
+    // Registers target, or changes which readiness it is watched for
+    void watch(int target, uint64_t token, bool read, bool write) {
+#if defined(GLYPH_EPOLL)
+        epoll_event ev{};
+        ev.events = (read ? EPOLLIN : 0u) | (write ? EPOLLOUT : 0u);
+        ev.data.u64 = token;
+        if (epoll_ctl(fd, EPOLL_CTL_MOD, target, &ev) != 0
+            && (errno != ENOENT || epoll_ctl(fd, EPOLL_CTL_ADD, target, &ev) != 0)) {
+            throw std::runtime_error(std::string("Cannot watch descriptor: ") + std::strerror(errno));
+        }
+#else
+        struct kevent changes[2];
+        void* udata = reinterpret_cast<void*>(static_cast<uintptr_t>(token));
+        EV_SET(&changes[0], target, EVFILT_READ, EV_ADD | (read ? EV_ENABLE : EV_DISABLE), 0, 0, udata);
+        EV_SET(&changes[1], target, EVFILT_WRITE, EV_ADD | (write ? EV_ENABLE : EV_DISABLE), 0, 0, udata);
+        if (kevent(fd, changes, 2, nullptr, 0, nullptr) != 0) {
+            throw std::runtime_error(std::string("Cannot watch descriptor: ") + std::strerror(errno));
         }
+#endif
     }
 
-    bool isOperator(char c) const {
-        return c == '+' || c == '-' || c == '*' || c == '^' || c == '%';
+    void unwatch(int target) {
+#if defined(GLYPH_EPOLL)
+        epoll_ctl(fd, EPOLL_CTL_DEL, target, nullptr);
+#else
+        struct kevent changes[2];
+        EV_SET(&changes[0], target, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+        EV_SET(&changes[1], target, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+        kevent(fd, changes, 2, nullptr, 0, nullptr);
+#endif
     }
 
-    bool isValidChar(char c) const {
-        return c == '*' || c == '(' || c == ')' || c == '+' ||
-            c == '-' || c == '^' || c == '%' || c == '_' || c == ':';
+    // Blocks until at least one registered descriptor is ready
+    void wait(std::vector<Event>& events) {
+        events.clear();
+#if defined(GLYPH_EPOLL)
+        epoll_event ready[64];
+        int n = epoll_wait(fd, ready, 64, -1);
+        for (int i = 0; i < n; i++) {
+            // Errors and hangups are reported as readable, so the next read
+            // sees them
+            bool hangup = (ready[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+            events.push_back({ ready[i].data.u64, (ready[i].events & EPOLLIN) != 0 || hangup, hangup });
+        }
+#else
+        struct kevent ready[64];
+        int n = kevent(fd, nullptr, 0, ready, 64, nullptr);
+        for (int i = 0; i < n; i++) {
+            uint64_t token = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ready[i].udata));
+            events.push_back({ token, ready[i].filter == EVFILT_READ, false });
+        }
+#endif
+        if (n < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("Event wait failed: ") + std::strerror(errno));
+        }
     }
 };
 
-// ============================================================================
-// Parser
-// ============================================================================
+static void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        throw std::runtime_error(std::string("Cannot make descriptor non-blocking: ") + std::strerror(errno));
+    }
+}
 
-class Parser {
+// Opens a listening socket for "unix:PATH" or "tcp:[HOST:]PORT" (the host
+// defaults to 127.0.0.1)
+static int listenOn(const std::string& address) {
+    int fd = -1;
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Invalid socket path: " + path);
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0) {
+            unlink(path.c_str()); // a socket left behind by an earlier run
+            if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    else if (address.compare(0, 4, "tcp:") == 0) {
+        std::string rest = address.substr(4);
+        size_t colon = rest.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : rest.substr(0, colon);
+        std::string port = colon == std::string::npos ? rest : rest.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* found = nullptr;
+        int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+        if (rc != 0) {
+            throw std::runtime_error("Cannot resolve " + rest + ": " + gai_strerror(rc));
+        }
+        for (addrinfo* ai = found; ai != nullptr && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(found);
+    }
+    else {
+        throw std::runtime_error("Expected unix:PATH, tcp:[HOST:]PORT or - for --serve, got " + address);
+    }
+
+    if (fd < 0 || listen(fd, SOMAXCONN) != 0) {
+        throw std::runtime_error("Cannot listen on " + address + ": " + std::strerror(errno));
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+// Single-threaded event loop that reads and writes every connection, with
+// evaluation on a work-stealing pool. Workers append finished responses to
+// their connection and wake the loop through a pipe; the loop writes them
+// out. All connections share the interpreter and so its program cache.
+class Server {
 private:
-    Lexer& lexer;
+    struct Connection {
+        uint64_t id;
+        int inFd;
+        int outFd;
+        std::string input;  // received bytes not yet framed
+        bool reading = true;
+        bool eof = false;
+        bool watchingWrite = false;
 
-public:
-    Parser(Lexer& lex) : lexer(lex) {}
+        std::mutex mutex;   // guards output, appended to by workers
+        std::string output;
+        std::atomic<size_t> inFlight{ 0 };
+        std::atomic<bool> queued{ false }; // on the ready list
+    };
+
+    // Tokens 0 and 1 are the listener and the wake pipe; a connection's
+    // input and output descriptors are 2 * id and 2 * id + 1.
+    static constexpr uint64_t LISTENER = 0;
+    static constexpr uint64_t WAKE = 1;
 
-    std::unique_ptr<ASTNode> parseExpression() {
-        char ch = lexer.peek();
+    GlyphInterpreter& interpreter;
+    NumericBackend backend;
+    WorkStealingPool pool;
+    EventPoller poller;
+    int listenFd = -1;
+    int wakeRead = -1;
+    int wakeWrite = -1;
+    std::unordered_map<uint64_t, std::shared_ptr<Connection>> connections;
+    uint64_t nextId = 1;
 
-        if (ch == '\0') {
-            throw std::runtime_error("Unexpected end of input");
+    std::mutex readyMutex;
+    std::vector<uint64_t> ready; // connections with new responses
+
+    void updateWatch(Connection& c) {
+        bool write = !c.output.empty();
+        c.watchingWrite = write;
+        if (c.inFd == c.outFd) {
+            poller.watch(c.inFd, 2 * c.id, c.reading, write);
+        }
+        else {
+            // A pipe whose writer has gone keeps reporting hangup, so an
+            // exhausted or paused input is left out of the poller entirely
+            if (c.eof || !c.reading) {
+                poller.unwatch(c.inFd);
+            }
+            else {
+                poller.watch(c.inFd, 2 * c.id, c.reading, false);
+            }
+            poller.watch(c.outFd, 2 * c.id + 1, false, write);
         }
+    }
 
-        if (ch == '_') {
-            lexer.consume();
-            return std::make_unique<ValueNode>();
+    void add(int inFd, int outFd) {
+        auto c = std::make_shared<Connection>();
+        c->id = nextId++;
+        c->inFd = inFd;
+        c->outFd = outFd;
+        connections.emplace(c->id, c);
+        updateWatch(*c);
+    }
+
+    void drop(Connection& c) {
+        poller.unwatch(c.inFd);
+        close(c.inFd);
+        if (c.outFd != c.inFd) {
+            poller.unwatch(c.outFd);
+            close(c.outFd);
         }
+        connections.erase(c.id);
+    }
 
-        if (ch == '(') {
-            lexer.consume(); // eat '('
+    // Called by workers once a response is in c.output
+    void notify(const std::shared_ptr<Connection>& c) {
+        if (c->queued.exchange(true)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(c->id);
+        }
+        char byte = 1;
+        ssize_t ignored = write(wakeWrite, &byte, 1); // a full pipe already means "wake up"
+        (void)ignored;
+    }
 
-            char next = lexer.peek();
+    // Hands every complete request in c.input to the pool, up to
+    // MAX_IN_FLIGHT; returns false on a malformed frame
+    bool dispatch(const std::shared_ptr<Connection>& c) {
+        size_t pos = 0;
+        while (c->inFlight < MAX_IN_FLIGHT && c->input.size() - pos >= REQUEST_HEADER_BYTES) {
+            uint64_t length = loadLittleEndian(c->input.data() + pos, 4);
+            uint64_t id = loadLittleEndian(c->input.data() + pos + 4, 8);
+            if (length > MAX_REQUEST_BYTES) {
+                return false;
+            }
+            if (c->input.size() - pos - REQUEST_HEADER_BYTES < length) {
+                break;
+            }
+            std::string program = c->input.substr(pos + REQUEST_HEADER_BYTES, length);
+            pos += REQUEST_HEADER_BYTES + length;
 
-            // Check for operators
-            if (lexer.isOperator(next)) {
-                char op = lexer.consume();
+            c->inFlight++;
+            pool.submit([this, c, id, program = std::move(program)](size_t) {
+                std::string response;
+                appendResponse(response, interpreter, id, program, backend);
+                {
+                    std::lock_guard<std::mutex> lock(c->mutex);
+                    c->output += response;
+                }
+                c->inFlight--;
+                notify(c);
+            });
+        }
+        c->input.erase(0, pos);
+        return true;
+    }
 
-                // Special case: % can be conditional
-                if (op == '%' && lexer.peek() == '(') {
-                    // It's a conditional: %(cond)(then)(else)
-                    auto cond = parseExpression();
-                    auto thenBranch = parseExpression();
-                    auto elseBranch = parseExpression();
-                    lexer.expect(')');
-                    return std::make_unique<CondNode>(
-                        std::move(cond),
-                        std::move(thenBranch),
-                        std::move(elseBranch)
-                    );
+    // Writes as much pending output as the descriptor takes; false on error
+    bool flush(Connection& c) {
+        std::lock_guard<std::mutex> lock(c.mutex);
+        size_t sent = 0;
+        while (sent < c.output.size()) {
+            ssize_t n = write(c.outFd, c.output.data() + sent, c.output.size() - sent);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
                 }
-                else {
-                    // Regular binary operation
-                    auto left = parseExpression();
-                    auto right = parseExpression();
-                    lexer.expect(')');
-                    return std::make_unique<BinaryOpNode>(op, std::move(left), std::move(right));
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
                 }
+                return false;
             }
+            sent += static_cast<size_t>(n);
+        }
+        c.output.erase(0, sent);
+        return true;
+    }
 
-            // Check for let binding
-            if (next == ':') {
-                lexer.consume(); // eat ':'
-                auto name = parseExpression();
-                auto value = parseExpression();
-                auto body = parseExpression();
-                lexer.expect(')');
-                return std::make_unique<LetNode>(
-                    std::move(name),
-                    std::move(value),
-                    std::move(body)
-                );
+    bool readInput(Connection& c) {
+        char buffer[SERVE_READ_CHUNK];
+        for (;;) {
+            ssize_t n = read(c.inFd, buffer, sizeof(buffer));
+            if (n > 0) {
+                c.input.append(buffer, static_cast<size_t>(n));
+                if (c.input.size() >= MAX_REQUEST_BYTES + REQUEST_HEADER_BYTES) {
+                    return true; // dispatch before buffering more
+                }
+                continue;
+            }
+            if (n == 0) {
+                c.eof = true;
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
             }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Brings c up to date after any event: frames new input, writes output,
+    // pauses or resumes reading, and closes it once the peer is done and
+    // every answer has been sent. Returns false if c was closed.
+    //
+    // hangup is an error or hangup on a descriptor c is not reading from: its
+    // output, or a socket whose reading is paused. Reading will never clear
+    // it, and answers can no longer be delivered, so c is closed.
+    bool service(const std::shared_ptr<Connection>& c, bool readable, bool hangup = false) {
+        Connection& conn = *c;
+        bool ok = !hangup;
+        if (ok && readable && conn.reading && !conn.eof) {
+            ok = readInput(conn);
+        }
+        ok = ok && dispatch(c);
+        if (ok) {
+            ok = flush(conn); // a no-op when nothing is pending
+        }
 
-            throw std::runtime_error("Invalid expression starting with '('");
+        std::unique_lock<std::mutex> lock(conn.mutex);
+        bool drained = conn.output.empty();
+        size_t pending = conn.output.size();
+        lock.unlock();
+        // After EOF, input left over once nothing is in flight is a
+        // truncated frame that can never complete
+        if (!ok || (conn.eof && conn.inFlight == 0 && drained)) {
+            drop(conn);
+            return false;
         }
 
-        throw std::runtime_error(std::string("Unexpected character: ") + ch);
+        bool reading = !conn.eof && conn.inFlight < MAX_IN_FLIGHT && pending < MAX_PENDING_OUTPUT;
+        if (reading != conn.reading || drained == conn.watchingWrite) {
+            conn.reading = reading;
+            lock.lock();
+            updateWatch(conn);
+        }
+        return true;
     }
-};
 
-// ============================================================================
-// Interpreter
-// ============================================================================
+    void acceptAll() {
+        for (;;) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return; // EAGAIN, or out of descriptors until some close
+            }
+            setNonBlocking(fd);
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // fails harmlessly on Unix sockets
+            add(fd, fd);
+        }
+    }
+
+    void drainWake() {
+        char buffer[256];
+        while (read(wakeRead, buffer, sizeof(buffer)) > 0) {
+        }
+        std::vector<uint64_t> ids;
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ids.swap(ready);
+        }
+        for (uint64_t id : ids) {
+            auto it = connections.find(id);
+            if (it == connections.end()) {
+                continue;
+            }
+            std::shared_ptr<Connection> c = it->second;
+            c->queued = false;
+            service(c, false);
+        }
+    }
 
-class GlyphInterpreter {
 public:
-    int run(const std::string& source) {
-        // Validate input - only allowed characters
-        for (char c : source) {
-            if (c != '*' && c != '(' && c != ')' && c != '+' &&
-                c != '-' && c != '^' && c != '%' && c != '_' && c != ':') {
-                throw std::runtime_error(std::string("Invalid character: ") + c);
+    Server(GlyphInterpreter& interp, NumericBackend numeric, size_t jobs)
+        : interpreter(interp), backend(numeric), pool(jobs) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::runtime_error(std::string("Cannot create wake pipe: ") + std::strerror(errno));
+        }
+        wakeRead = fds[0];
+        wakeWrite = fds[1];
+        setNonBlocking(wakeRead);
+        setNonBlocking(wakeWrite);
+        poller.watch(wakeRead, WAKE, true, false);
+    }
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    ~Server() {
+        pool.wait();
+        for (auto& entry : connections) {
+            close(entry.second->inFd);
+            if (entry.second->outFd != entry.second->inFd) {
+                close(entry.second->outFd);
             }
         }
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+        close(wakeRead);
+        close(wakeWrite);
+    }
 
-        Lexer lexer(source);
-        Parser parser(lexer);
+    // Serves connections on address until the process is stopped
+    void listen(const std::string& address) {
+        listenFd = listenOn(address);
+        poller.watch(listenFd, LISTENER, true, false);
+        run();
+    }
 
-        auto ast = parser.parseExpression();
+    // Serves one connection on a pair of pipes until the input ends and
+    // every answer has been written
+    void serveStreams(int inFd, int outFd) {
+        // Readiness is meaningless for regular files, which epoll rejects
+        struct stat info;
+        if ((fstat(inFd, &info) == 0 && S_ISREG(info.st_mode))
+            || (fstat(outFd, &info) == 0 && S_ISREG(info.st_mode))) {
+            throw std::runtime_error("--serve - needs pipes or sockets, not files; use --batch for files");
+        }
+        setNonBlocking(inFd);
+        setNonBlocking(outFd);
+        add(inFd, outFd);
+        run();
+    }
 
-        std::map<int, int> env;
-        return ast->evaluate(env);
+private:
+    void run() {
+        std::vector<EventPoller::Event> events;
+        while (listenFd >= 0 || !connections.empty()) {
+            poller.wait(events);
+            for (const EventPoller::Event& ev : events) {
+                if (ev.token == LISTENER) {
+                    acceptAll();
+                    continue;
+                }
+                if (ev.token == WAKE) {
+                    drainWake();
+                    continue;
+                }
+                auto it = connections.find(ev.token / 2);
+                if (it != connections.end()) {
+                    std::shared_ptr<Connection> c = it->second;
+                    bool output = ev.token % 2 == 1;
+                    service(c, ev.readable, ev.hangup && (output || !c->reading));
+                }
+            }
+        }
     }
 };
 
+#endif
+
+// Runs --serve: "unix:PATH" or "tcp:[HOST:]PORT" listens for connections; "-"
+// serves requests from stdin and answers on stdout
+static int runServer(GlyphInterpreter& interpreter, const std::string& address,
+    NumericBackend backend, size_t jobs) {
+#ifdef _WIN32
+    (void)interpreter;
+    (void)address;
+    (void)backend;
+    (void)jobs;
+    std::cerr << "--serve is not supported on Windows" << std::endl;
+    return 1;
+#else
+    signal(SIGPIPE, SIG_IGN); // a vanished client surfaces as EPIPE
+    try {
+        Server server(interpreter, backend, jobs);
+        if (address == "-") {
+            server.serveStreams(STDIN_FILENO, STDOUT_FILENO);
+        }
+        else {
+            std::cerr << "glyph: serving on " << address << std::endl;
+            server.listen(address);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+#endif
+}
+
+// ============================================================================
+// Compiled Programs
+// ============================================================================
+
+// Runs --compile: the program in sourcePath, compiled and written to outPath
+// as a bytecode file
+static int compileFile(GlyphInterpreter& interpreter, const char* sourcePath, const char* outPath) {
+    std::ifstream in(sourcePath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << sourcePath << std::endl;
+        return 1;
+    }
+    std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    while (!source.empty() && (source.back() == '\n' || source.back() == '\r')) {
+        source.pop_back();
+    }
+
+    std::string image;
+    try {
+        image = BytecodeFile::encode(interpreter.compile(source));
+    }
+    catch (const std::exception& e) {
+        std::cerr << sourcePath << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    out.write(image.data(), static_cast<std::streamsize>(image.size()));
+    out.close();
+    if (!out) {
+        std::cerr << "Cannot write " << outPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Runs --run: maps a bytecode file and executes it where it lies, printing
+// the value
+static int runCompiled(GlyphInterpreter& interpreter, const char* path, NumericBackend backend) {
+    if (backend != NumericBackend::INT32) {
+        // Constants are folded in int32 when compiling; other backends
+        // evaluate from source
+        std::cerr << "--run supports only --numeric int32" << std::endl;
+        return 1;
+    }
+    MappedFile mapped;
+    if (!mapped.open(path)) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+    }
+    try {
+        BytecodeFile program;
+        program.load(mapped.view());
+        std::cout << interpreter.execute(program.view()) << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << path << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// Statistics Report
+// ============================================================================
+
+// Human-readable --stats summary
+static void printStats(std::ostream& out, const RunStats& stats) {
+    out << "stats: " << stats.programs << " programs, " << stats.failures << " failed" << std::endl;
+    out << "  time: validate " << stats.validateNs / 1e6 << " ms, parse " << stats.parseNs / 1e6
+        << " ms, optimize " << stats.optimizeNs / 1e6 << " ms, evaluate " << stats.evaluateNs / 1e6 << " ms" << std::endl;
+    out << "  parsed nodes:";
+    for (size_t i = 0; i < RunStats::NODE_TYPES; i++) {
+        out << " " << RunStats::nodeTypeName(i) << " " << stats.parsedNodes[i];
+    }
+    out << std::endl << "  evaluated nodes:";
+    for (size_t i = 0; i < RunStats::NODE_TYPES; i++) {
+        out << " " << RunStats::nodeTypeName(i) << " " << stats.evaluatedNodes[i];
+    }
+    out << std::endl << "  operators:";
+    for (size_t i = 0; i < RunStats::OPERATORS; i++) {
+        out << " " << RunStats::OPERATOR_CHARS[i] << " " << stats.operatorEvaluations[i];
+    }
+    out << std::endl;
+    out << "  max nesting " << stats.maxNesting << ", max evaluation depth " << stats.maxEvalDepth << std::endl;
+    out << "  binds: " << stats.binds << " (" << stats.bindBytes << " bytes)" << std::endl;
+}
+
 // ============================================================================
 // Main Program
 // ============================================================================
 
-int main() {
+// Flushes out when reading the next line from std::cin could block, so the
+// prompt and every result before it are visible while the REPL waits
+static void awaitInput(std::ostream& out) {
+    if (std::cin.rdbuf()->in_avail() <= 0) {
+        out.flush();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    NumericBackend backend = NumericBackend::INT32;
+    const char* batchPath = nullptr;
+    size_t jobs = 1;
+    size_t forkThreads = 0;
+    CostPolicy costPolicy;
+    size_t cacheMegabytes = 0;
+    bool memoize = false;
+    bool showStats = false;
+    uint64_t maxSteps = 0;
+    uint64_t timeoutMs = 0;
+    const char* serveAddress = nullptr;
+    const char* compilePath = nullptr;
+    const char* outputPath = nullptr;
+    const char* runPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--numeric" && i + 1 < argc && parseNumericBackend(argv[i + 1], backend)) {
+            i++;
+            continue;
+        }
+        if (arg == "--numeric" && i + 1 < argc && std::string(argv[i + 1]) == "auto") {
+            // int64 or bigint per program, by cost analysis; results are bigint's
+            costPolicy.autoBackend = true;
+            backend = NumericBackend::BIGINT;
+            i++;
+            continue;
+        }
+        if (arg == "--max-cost" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            costPolicy.maxCost = std::stoull(argv[++i]);
+            continue;
+        }
+        if (arg == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+            continue;
+        }
+        if (arg == "--jobs" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            // 0 means one worker per hardware thread
+            jobs = std::stoul(argv[++i]);
+            if (jobs == 0) {
+                jobs = std::max(1u, std::thread::hardware_concurrency());
+            }
+            continue;
+        }
+        if (arg == "--parallel" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            // Workers for subtrees of one program; 0 means one per hardware thread
+            forkThreads = std::stoul(argv[++i]);
+            if (forkThreads == 0) {
+                forkThreads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            continue;
+        }
+        if (arg == "--cache" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            cacheMegabytes = std::stoul(argv[++i]);
+            continue;
+        }
+        if (arg == "--memo") {
+            memoize = true;
+            continue;
+        }
+        if (arg == "--max-steps" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            maxSteps = std::stoull(argv[++i]);
+            continue;
+        }
+        if (arg == "--timeout" && i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+            timeoutMs = std::stoull(argv[++i]);
+            continue;
+        }
+        if (arg == "--serve" && i + 1 < argc) {
+            serveAddress = argv[++i];
+            continue;
+        }
+        if (arg == "--compile" && i + 1 < argc) {
+            compilePath = argv[++i];
+            continue;
+        }
+        if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+            continue;
+        }
+        if (arg == "--run" && i + 1 < argc) {
+            runPath = argv[++i];
+            continue;
+        }
+        if (arg == "--stats") {
+            showStats = true;
+            continue;
+        }
+        std::cerr << "Usage: glyph [--numeric int32|int64|checked-int64|bigint|auto] [--batch FILE|-] [--jobs N] [--parallel N] [--cache MB] [--memo] [--stats] [--max-steps N] [--timeout MS] [--max-cost N] [--serve unix:PATH|tcp:[HOST:]PORT|-] [--compile FILE -o OUT] [--run OUT]" << std::endl;
+        return 1;
+    }
+    if ((compilePath == nullptr) != (outputPath == nullptr)) {
+        std::cerr << "--compile and -o must be given together" << std::endl;
+        return 1;
+    }
+
     GlyphInterpreter interpreter;
+    if (serveAddress != nullptr && cacheMegabytes == 0) {
+        // Clients tend to resend the same programs, so a server caches by default
+        cacheMegabytes = SERVE_DEFAULT_CACHE_MB;
+    }
+    if (cacheMegabytes != 0) {
+        interpreter.setCacheBudget(cacheMegabytes << 20);
+        interpreter.setResultCache(true);
+    }
+    interpreter.setMemoize(memoize);
+    interpreter.setParallel(forkThreads);
+    interpreter.setStats(showStats);
+    interpreter.setStepLimit(maxSteps);
+    interpreter.setTimeout(std::chrono::milliseconds(timeoutMs));
+
+    if (serveAddress != nullptr) {
+        return runServer(interpreter, serveAddress, backend, jobs);
+    }
+    if (compilePath != nullptr) {
+        return compileFile(interpreter, compilePath, outputPath);
+    }
+    if (runPath != nullptr) {
+        return runCompiled(interpreter, runPath, backend);
+    }
+
+    if (batchPath != nullptr) {
+        // Regular files are mapped and sliced in place; anything else is
+        // streamed.
+        MappedFile mapped;
+        std::ifstream file;
+        std::unique_ptr<LineSource> in;
+        if (std::string(batchPath) == "-") {
+            std::ios::sync_with_stdio(false);
+            in = std::make_unique<StreamLineSource>(std::cin);
+        }
+        else if (mapped.open(batchPath)) {
+            in = std::make_unique<MappedLineSource>(mapped.view());
+        }
+        else {
+            file.open(batchPath, std::ios::binary);
+            if (!file) {
+                std::cerr << "Cannot open " << batchPath << std::endl;
+                return 1;
+            }
+            in = std::make_unique<StreamLineSource>(file);
+        }
+
+        if (jobs > 1) {
+            runBatchParallel(interpreter, *in, stdout, backend, jobs, costPolicy);
+        }
+        else {
+            runBatch(interpreter, *in, stdout, backend, costPolicy);
+        }
+
+        if (cacheMegabytes != 0) {
+            ProgramCache::Stats stats = interpreter.cacheStats();
+            std::cerr << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                << stats.evictions << " evictions, " << stats.entries << " entries, "
+                << stats.bytes << " bytes" << std::endl;
+        }
+        if (memoize) {
+            GlyphInterpreter::MemoStats stats = interpreter.memoStats();
+            std::cerr << "memo: " << stats.evaluations << " subtree evaluations saved ("
+                << stats.nodes << " nodes)" << std::endl;
+        }
+        if (showStats) {
+            printStats(std::cerr, interpreter.stats());
+        }
+        return 0;
+    }
+
+    // Output is buffered and flushed only when the next read would block
+    // (see awaitInput) and at exit, not after every line; piped input is
+    // answered in large writes.
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
 
-    std::cout << "=== Glyph Programming Language Interpreter ===" << std::endl;
-    std::cout << "Valid characters: * ( ) + - ^ % _ :" << std::endl << std::endl;
+    std::cout << "=== Glyph Programming Language Interpreter ===" << '\n';
+    std::cout << "Valid characters: * ( ) + - ^ % _ :" << '\n' << '\n';
 
     // Test programs from the specification
     std::vector<std::pair<std::string, std::string>> testPrograms = {
@@ -300,28 +1231,32 @@ int main() {
 
     for (const auto& [program, description] : testPrograms) {
         try {
-            int result = interpreter.run(program);
-            std::cout << "Program: " << program << std::endl;
-            std::cout << "  Desc: " << description << std::endl;
-            std::cout << "  Result: " << result << std::endl;
-            std::cout << std::endl;
+            std::string result = interpreter.runAs(program, backend);
+            std::cout << "Program: " << program << '\n';
+            std::cout << "  Desc: " << description << '\n';
+            std::cout << "  Result: " << result << '\n';
+            std::cout << '\n';
         }
         catch (const std::exception& e) {
-            std::cout << "Program: " << program << std::endl;
-            std::cout << "  Desc: " << description << std::endl;
-            std::cout << "  ERROR: " << e.what() << std::endl;
-            std::cout << std::endl;
+            std::cout << "Program: " << program << '\n';
+            std::cout << "  Desc: " << description << '\n';
+            std::cout << "  ERROR: " << e.what() << '\n';
+            std::cout << '\n';
         }
     }
 
     // Interactive mode
-    std::cout << "=== Interactive Mode ===" << std::endl;
-    std::cout << "Enter Glyph expressions (or 'quit' to exit):" << std::endl;
+    interpreter.resetStats();
+    std::cout << "=== Interactive Mode ===" << '\n';
+    std::cout << "Enter Glyph expressions (or 'quit' to exit):" << '\n';
 
-    std::string line;
+    std::string line; // reused, so steady-state reads do not allocate
     while (true) {
         std::cout << "> ";
-        std::getline(std::cin, line);
+        awaitInput(std::cout);
+        if (!std::getline(std::cin, line)) {
+            break;
+        }
 
         if (line == "quit" || line == "exit" || line == "q") {
             break;
@@ -332,14 +1267,22 @@ int main() {
         }
 
         try {
-            int result = interpreter.run(line);
-            std::cout << "=> " << result << std::endl;
+            std::string result = interpreter.runAs(line, backend);
+            std::cout << "=> " << result << '\n';
         }
         catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            std::cout << "Error: " << e.what() << '\n';
+        }
+
+        // Per expression: forget the counters of everything run before
+        if (showStats) {
+            std::cout.flush(); // the result goes out before its statistics
+            printStats(std::cerr, interpreter.stats());
+            interpreter.resetStats();
         }
     }
 
+    std::cout.flush();
     return 0;
 }
 
@@ -1,8 +1,6609 @@
-﻿// glyph.h : включаемый файл для стандартных системных включаемых файлов
-// или включаемые файлы для конкретного проекта.
+﻿#pragma once
 
-#pragma once
+// Glyph interpreter core: AST, numeric backends, evaluators, optimizer,
+// parser, bytecode VM, program cache and GlyphInterpreter. Header-only, so
+// the CLI and glyph-bench share one definition.
 
-#include <iostream>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <cctype>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <new>
+#include <deque>
+#include <climits>
+#include <limits>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <iterator>
+#include <chrono>
+#include <iosfwd>
+#include <type_traits>
+#include <exception>
 
-// TODO: установите здесь ссылки на дополнительные заголовки, требующиеся для программы.
+#if defined(__x86_64__) || defined(_M_X64)
+#define GLYPH_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define GLYPH_TARGET_AVX2
+#else
+#define GLYPH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GLYPH_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// Native code generation (see NativeProgram) targets x86-64 System V
+#if defined(__x86_64__) && !defined(_WIN32)
+#define GLYPH_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Arena
+// ============================================================================
+
+// Bump allocator for AST nodes. Nodes only point at other nodes of the same
+// arena, so a whole tree is released at once by dropping the blocks; node
+// destructors are never run.
+class Arena {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t nextBlock = 0; // first block not handed out since the last reset
+    char* cursor = nullptr;
+    char* limit = nullptr;
+
+    void grow(size_t minSize) {
+        // Reuse blocks retained by reset() before allocating new ones
+        while (nextBlock < blocks.size() && blocks[nextBlock].size < minSize) {
+            nextBlock++;
+        }
+        if (nextBlock == blocks.size()) {
+            size_t size = std::max(BLOCK_SIZE, minSize);
+            blocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+        }
+        Block& block = blocks[nextBlock++];
+        cursor = block.data.get();
+        limit = cursor + block.size;
+    }
+
+    static std::uintptr_t alignUp(const char* p, size_t align) {
+        return (reinterpret_cast<std::uintptr_t>(p) + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+    }
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    void* allocate(size_t size, size_t align) {
+        std::uintptr_t p = alignUp(cursor, align);
+        if (p + size > reinterpret_cast<std::uintptr_t>(limit)) {
+            grow(size + align);
+            p = alignUp(cursor, align);
+        }
+        cursor = reinterpret_cast<char*>(p + size);
+        return reinterpret_cast<void*>(p);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Bytes held in blocks, in use or retained by reset()
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& b : blocks) {
+            total += b.size;
+        }
+        return total;
+    }
+
+    // Forget every allocation but keep the blocks for reuse
+    void reset() {
+        nextBlock = 0;
+        cursor = nullptr;
+        limit = nullptr;
+    }
+};
+
+// ============================================================================
+// AST Node Types
+// ============================================================================
+
+enum class NodeType : uint8_t {
+    VALUE,      // The underscore literal _
+    BINARY_OP,  // +, -, *, ^, %
+    LET,        // : binding
+    COND,       // % conditional
+    VAR,        // Variable reference
+    CONST       // Folded constant (produced by the Optimizer)
+};
+
+// Dense dispatch tag: NodeType with the operator of a binary node folded in,
+// so the tree evaluator branches once per node instead of on the type and
+// then again on the operator
+enum class NodeKind : uint8_t {
+    UNIT,
+    CONST,
+    VAR,
+    ADD,
+    SUB,
+    MUL,
+    POW,
+    MOD,
+    LET,
+    COND,
+    OTHER_OP    // a binary operator outside the language
+};
+
+constexpr NodeKind binaryKind(char op) {
+    return op == '+' ? NodeKind::ADD
+        : op == '-' ? NodeKind::SUB
+        : op == '*' ? NodeKind::MUL
+        : op == '^' ? NodeKind::POW
+        : op == '%' ? NodeKind::MOD
+        : NodeKind::OTHER_OP;
+}
+
+// ============================================================================
+// Environment
+// ============================================================================
+
+// Persistent environment: every binding is an immutable frame pointing at its
+// enclosing scope. A let keeps its new frame alive only while its body runs, so
+// binding and unbinding are O(1) and the enclosing environment is never copied
+// or mutated. Names and values share the evaluator's numeric type.
+template <typename Value>
+class BasicEnvironment {
+private:
+    const BasicEnvironment* parent;
+    Value name;
+    Value value;
+
+public:
+    // Empty (root) environment
+    BasicEnvironment() : parent(nullptr), name(), value() {}
+
+    // Environment extending `enclosing` with name -> value
+    BasicEnvironment(const BasicEnvironment& enclosing, Value n, Value v)
+        : parent(&enclosing), name(std::move(n)), value(std::move(v)) {}
+
+    // Innermost value bound to n, or nullptr if n is unbound
+    const Value* lookup(const Value& n) const {
+        for (const BasicEnvironment* e = this; e->parent != nullptr; e = e->parent) {
+            if (e->name == n) {
+                return &e->value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+using Environment = BasicEnvironment<int>;
+
+// Nodes are plain data; evaluation is done by the iterative Evaluator below so
+// that arbitrarily deep trees never recurse on the native stack. They live in
+// an Arena that never runs destructors, so there is no vtable.
+class ASTNode {
+public:
+    // Nodes in the subtree rooted here, counting a shared subtree once per
+    // path and saturating at MAX_WEIGHT. Set when the node is built, which is
+    // possible because children always exist before their parent.
+    static constexpr uint16_t MAX_WEIGHT = UINT16_MAX;
+
+    NodeType type;
+    NodeKind kind;
+    uint16_t weight = 1; // fits in padding, so no node grows
+    int evaluate(const Environment& env) const;
+
+protected:
+    static uint16_t weigh(const ASTNode* a, const ASTNode* b, const ASTNode* c = nullptr) {
+        uint32_t w = 1u + a->weight + b->weight + (c != nullptr ? c->weight : 0u);
+        return static_cast<uint16_t>(std::min<uint32_t>(w, MAX_WEIGHT));
+    }
+};
+
+// Value node - represents underscore (_) which equals 1.
+// It carries no state, so every _ in every program shares one instance.
+class ValueNode : public ASTNode {
+public:
+    ValueNode() {
+        type = NodeType::VALUE;
+        kind = NodeKind::UNIT;
+    }
+
+    static const ValueNode* instance() {
+        static const ValueNode unit;
+        return &unit;
+    }
+};
+
+// Variable node - represents a bound name (by index)
+class VarNode : public ASTNode {
+public:
+    int varIndex;
+    VarNode(int idx) : varIndex(idx) {
+        type = NodeType::VAR;
+        kind = NodeKind::VAR;
+    }
+};
+
+// Constant node - a subtree the Optimizer evaluated ahead of time
+class ConstNode : public ASTNode {
+public:
+    int value;
+    ConstNode(int v) : value(v) {
+        type = NodeType::CONST;
+        kind = NodeKind::CONST;
+    }
+};
+
+// Binary operation node
+class BinaryOpNode : public ASTNode {
+public:
+    char op;
+    const ASTNode* left;
+    const ASTNode* right;
+
+    BinaryOpNode(char operation, const ASTNode* l, const ASTNode* r)
+        : op(operation), left(l), right(r) {
+        type = NodeType::BINARY_OP;
+        kind = binaryKind(operation);
+        weight = weigh(l, r);
+    }
+};
+
+// Let binding node: :(name)(value)(body)
+class LetNode : public ASTNode {
+public:
+    const ASTNode* name;
+    const ASTNode* value;
+    const ASTNode* body;
+
+    LetNode(const ASTNode* n, const ASTNode* v, const ASTNode* b)
+        : name(n), value(v), body(b) {
+        type = NodeType::LET;
+        kind = NodeKind::LET;
+        weight = weigh(n, v, b);
+    }
+};
+
+// Conditional node: %(condition)(then)(else)
+class CondNode : public ASTNode {
+public:
+    const ASTNode* condition;
+    const ASTNode* thenBranch;
+    const ASTNode* elseBranch;
+
+    CondNode(const ASTNode* c, const ASTNode* t, const ASTNode* e)
+        : condition(c), thenBranch(t), elseBranch(e) {
+        type = NodeType::COND;
+        kind = NodeKind::COND;
+        weight = weigh(c, t, e);
+    }
+};
+
+// Stores node's children in source order (name, value, body for a let) and
+// returns how many there are
+inline int astChildren(const ASTNode* node, const ASTNode* out[3]) {
+    switch (node->type) {
+    case NodeType::BINARY_OP: {
+        const auto* bin = static_cast<const BinaryOpNode*>(node);
+        out[0] = bin->left;
+        out[1] = bin->right;
+        return 2;
+    }
+    case NodeType::LET: {
+        const auto* let = static_cast<const LetNode*>(node);
+        out[0] = let->name;
+        out[1] = let->value;
+        out[2] = let->body;
+        return 3;
+    }
+    case NodeType::COND: {
+        const auto* cond = static_cast<const CondNode*>(node);
+        out[0] = cond->condition;
+        out[1] = cond->thenBranch;
+        out[2] = cond->elseBranch;
+        return 3;
+    }
+    default:
+        return 0;
+    }
+}
+
+// ============================================================================
+// Error Codes
+// ============================================================================
+
+// Every way a program can fail, so the non-throwing entry points (see
+// RunResult) can report an error without building its message. detail holds
+// the offending character or the depth limit, where the message has one.
+enum class GlyphError : uint8_t {
+    NONE,
+    INVALID_CHARACTER,      // detail: the character
+    UNEXPECTED_END,
+    UNEXPECTED_CHARACTER,   // detail: the character
+    INVALID_EXPRESSION,     // '(' not followed by an operator or ':'
+    EXPECTED_CLOSE,         // detail: the character found instead of ')'
+    NESTING_TOO_DEEP,       // detail: the depth limit
+    MODULO_BY_ZERO,
+    ZERO_NEGATIVE_POWER,
+    INTEGER_OVERFLOW,       // detail: the operator
+    INTEGER_TOO_LARGE,
+    STEP_LIMIT,
+    DEADLINE
+};
+
+// The message run() would throw for this error
+inline std::string glyphErrorMessage(GlyphError error, size_t detail = 0) {
+    const char c = static_cast<char>(detail);
+    switch (error) {
+    case GlyphError::NONE: return "";
+    case GlyphError::INVALID_CHARACTER: return std::string("Invalid character: ") + c;
+    case GlyphError::UNEXPECTED_END: return "Unexpected end of input";
+    case GlyphError::UNEXPECTED_CHARACTER: return std::string("Unexpected character: ") + c;
+    case GlyphError::INVALID_EXPRESSION: return "Invalid expression starting with '('";
+    case GlyphError::EXPECTED_CLOSE:
+        // At the end of input the character is '\0', where what() stops
+        return c == '\0' ? "Expected ')' but got '" : std::string("Expected ')' but got '") + c + "'";
+    case GlyphError::NESTING_TOO_DEEP: return "Maximum nesting depth of " + std::to_string(detail) + " exceeded";
+    case GlyphError::MODULO_BY_ZERO: return "Modulo by zero";
+    case GlyphError::ZERO_NEGATIVE_POWER: return "Zero raised to a negative power";
+    case GlyphError::INTEGER_OVERFLOW: return std::string("Integer overflow in '") + c + "'";
+    case GlyphError::INTEGER_TOO_LARGE: return "Integer too large";
+    case GlyphError::STEP_LIMIT: return "Step limit exceeded";
+    case GlyphError::DEADLINE: return "Deadline exceeded";
+    }
+    return "Unknown error";
+}
+
+// A value, or the error a program failed with and the byte offset at which
+// it was detected: the offending byte for a syntax error, the end of input
+// if it ended early, and the byte that completed the failing operation for
+// an evaluation error. Building the message is left to message().
+template <typename Value>
+class BasicRunResult {
+private:
+    Value result{};
+    GlyphError code = GlyphError::NONE;
+    size_t detail = 0;
+    size_t at = 0;
+
+public:
+    BasicRunResult() = default;
+    BasicRunResult(Value v) : result(std::move(v)) {}
+    BasicRunResult(GlyphError error, size_t errorDetail, size_t offset)
+        : code(error), detail(errorDetail), at(offset) {}
+
+    bool ok() const { return code == GlyphError::NONE; }
+    explicit operator bool() const { return ok(); }
+
+    // The program's value; meaningful only when ok()
+    const Value& value() const { return result; }
+
+    GlyphError error() const { return code; }
+    size_t offset() const { return at; }
+    std::string message() const { return glyphErrorMessage(code, detail); }
+};
+
+using RunResult = BasicRunResult<int>;
+
+// ============================================================================
+// Numeric Backends
+// ============================================================================
+
+// Overflow-checked primitives. They store the (wrapped) result in `out` and
+// return true when it does not fit in T.
+template <typename T>
+inline bool addOverflow(T a, T b, T& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(a, b, &out);
+#else
+    if ((b > 0 && a > std::numeric_limits<T>::max() - b) ||
+        (b < 0 && a < std::numeric_limits<T>::min() - b)) {
+        return true;
+    }
+    out = a + b;
+    return false;
+#endif
+}
+
+template <typename T>
+inline bool subOverflow(T a, T b, T& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(a, b, &out);
+#else
+    if ((b < 0 && a > std::numeric_limits<T>::max() + b) ||
+        (b > 0 && a < std::numeric_limits<T>::min() + b)) {
+        return true;
+    }
+    out = a - b;
+    return false;
+#endif
+}
+
+template <typename T>
+inline bool mulOverflow(T a, T b, T& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(a, b, &out);
+#else
+    const T max = std::numeric_limits<T>::max();
+    const T min = std::numeric_limits<T>::min();
+    if (a != 0 && b != 0) {
+        if (a > 0 ? (b > 0 ? a > max / b : b < min / a)
+                  : (b > 0 ? a < min / b : a < max / b)) {
+            return true;
+        }
+    }
+    out = a * b;
+    return false;
+#endif
+}
+
+// Integer exponentiation by squaring, shared by the tree evaluator and the VM.
+// A negative exponent yields 1 / base^n truncated toward zero, like integer
+// division. Results outside the range of T are an error rather than wrapping.
+// Stores base ^ exponent in out, or returns why it has no value.
+template <typename T>
+inline GlyphError powStatus(T base, T exponent, T& out) {
+    if (exponent < 0) {
+        if (base == 0) {
+            return GlyphError::ZERO_NEGATIVE_POWER;
+        }
+        out = (base == 1 || base == -1) ? ((exponent & 1) ? base : 1) : 0;
+        return GlyphError::NONE;
+    }
+
+    T result = 1;
+    T factor = base;
+    for (;;) {
+        if ((exponent & 1) && mulOverflow(result, factor, result)) {
+            return GlyphError::INTEGER_OVERFLOW;
+        }
+        exponent >>= 1;
+        if (exponent == 0) {
+            out = result;
+            return GlyphError::NONE;
+        }
+        // The highest exponent bit always multiplies the final square into
+        // the result, so a square that no longer fits can never come back.
+        if (mulOverflow(factor, factor, factor)) {
+            return GlyphError::INTEGER_OVERFLOW;
+        }
+    }
+}
+
+template <typename T>
+inline T powChecked(T base, T exponent) {
+    T result;
+    GlyphError error = powStatus(base, exponent, result);
+    if (error != GlyphError::NONE) {
+        throw std::runtime_error(glyphErrorMessage(error, '^'));
+    }
+    return result;
+}
+
+inline int powInt(int base, int exponent) {
+    return powChecked(base, exponent);
+}
+
+// Truncated remainder. A zero divisor is an error instead of a hardware trap,
+// and min % -1 (which overflows the quotient) is 0.
+template <typename T>
+inline GlyphError modStatus(T a, T b, T& out) {
+    if (b == 0) {
+        return GlyphError::MODULO_BY_ZERO;
+    }
+    out = b == -1 ? 0 : a % b;
+    return GlyphError::NONE;
+}
+
+template <typename T>
+inline T modChecked(T a, T b) {
+    T result;
+    GlyphError error = modStatus(a, b, result);
+    if (error != GlyphError::NONE) {
+        throw std::runtime_error(glyphErrorMessage(error));
+    }
+    return result;
+}
+
+inline int modInt(int a, int b) {
+    return modChecked(a, b);
+}
+
+// Arbitrary-precision integer. Values that fit in int64 are kept inline and
+// never allocate; larger magnitudes spill into little-endian 32-bit limbs.
+// Division-like operations truncate toward zero, as with the int backends.
+class BigInt {
+public:
+    // Results wider than this are rejected instead of exhausting memory
+    static constexpr size_t MAX_BITS = size_t(1) << 20;
+
+private:
+    using Limb = uint32_t;
+    using Magnitude = std::vector<Limb>;
+
+    // Below this many limbs schoolbook multiplication beats Karatsuba
+    static constexpr size_t KARATSUBA_THRESHOLD = 32;
+
+    int64_t small;   // the value itself while limbs is empty
+    bool negative;   // sign of a limb-backed value
+    Magnitude limbs; // magnitude of values outside the int64 range
+
+    bool isSmall() const { return limbs.empty(); }
+
+    static Magnitude magnitudeOf(int64_t v) {
+        uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+        Magnitude m;
+        while (u != 0) {
+            m.push_back(static_cast<Limb>(u));
+            u >>= 32;
+        }
+        return m;
+    }
+
+    Magnitude magnitude() const {
+        return isSmall() ? magnitudeOf(small) : limbs;
+    }
+
+    static void trim(Magnitude& m) {
+        while (!m.empty() && m.back() == 0) {
+            m.pop_back();
+        }
+    }
+
+    // Builds a normalized value: anything that fits in int64 goes inline
+    static BigInt fromMagnitude(Magnitude m, bool neg) {
+        trim(m);
+        BigInt r;
+        if (m.size() <= 2) {
+            uint64_t u = 0;
+            for (size_t i = m.size(); i-- > 0;) {
+                u = (u << 32) | m[i];
+            }
+            if (!neg && u <= static_cast<uint64_t>(INT64_MAX)) {
+                r.small = static_cast<int64_t>(u);
+                return r;
+            }
+            if (neg && u <= static_cast<uint64_t>(INT64_MAX) + 1) {
+                r.small = -static_cast<int64_t>(u - 1) - 1;
+                return r;
+            }
+        }
+        r.negative = neg;
+        r.limbs = std::move(m);
+        return r;
+    }
+
+    static size_t bitLength(const Magnitude& m) {
+        if (m.empty()) {
+            return 0;
+        }
+        size_t bits = (m.size() - 1) * 32;
+        for (Limb top = m.back(); top != 0; top >>= 1) {
+            bits++;
+        }
+        return bits;
+    }
+
+    // bitLength(magnitude()) without building a small value's limbs
+    size_t bitWidth() const {
+        if (!isSmall()) {
+            return bitLength(limbs);
+        }
+        size_t bits = 0;
+        for (uint64_t u = small < 0 ? 0 - static_cast<uint64_t>(small) : static_cast<uint64_t>(small); u != 0; u >>= 1) {
+            bits++;
+        }
+        return bits;
+    }
+
+    static int compareMagnitude(const Magnitude& a, const Magnitude& b) {
+        if (a.size() != b.size()) {
+            return a.size() < b.size() ? -1 : 1;
+        }
+        for (size_t i = a.size(); i-- > 0;) {
+            if (a[i] != b[i]) {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    static Magnitude addMagnitude(const Magnitude& a, const Magnitude& b) {
+        const Magnitude& longer = a.size() >= b.size() ? a : b;
+        const Magnitude& shorter = a.size() >= b.size() ? b : a;
+        Magnitude r(longer.size() + 1, 0);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < longer.size(); i++) {
+            uint64_t t = static_cast<uint64_t>(longer[i]) + (i < shorter.size() ? shorter[i] : 0) + carry;
+            r[i] = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+        r[longer.size()] = static_cast<Limb>(carry);
+        trim(r);
+        return r;
+    }
+
+    // a - b for a >= b
+    static Magnitude subMagnitude(const Magnitude& a, const Magnitude& b) {
+        Magnitude r(a.size(), 0);
+        int64_t borrow = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            int64_t t = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+            borrow = t < 0 ? 1 : 0;
+            r[i] = static_cast<Limb>(t + (borrow << 32));
+        }
+        trim(r);
+        return r;
+    }
+
+    // acc += x << (32 * shift); acc must be wide enough for the sum
+    static void addShifted(Magnitude& acc, const Magnitude& x, size_t shift) {
+        uint64_t carry = 0;
+        size_t i = 0;
+        for (; i < x.size(); i++) {
+            uint64_t t = static_cast<uint64_t>(acc[i + shift]) + x[i] + carry;
+            acc[i + shift] = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+        for (; carry != 0; i++) {
+            uint64_t t = static_cast<uint64_t>(acc[i + shift]) + carry;
+            acc[i + shift] = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+    }
+
+    static Magnitude slice(const Magnitude& m, size_t from, size_t to) {
+        from = std::min(from, m.size());
+        to = std::min(to, m.size());
+        Magnitude r(m.begin() + from, m.begin() + to);
+        trim(r);
+        return r;
+    }
+
+    static Magnitude mulSchoolbook(const Magnitude& a, const Magnitude& b) {
+        Magnitude r(a.size() + b.size(), 0);
+        for (size_t i = 0; i < a.size(); i++) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < b.size(); j++) {
+                uint64_t t = static_cast<uint64_t>(a[i]) * b[j] + r[i + j] + carry;
+                r[i + j] = static_cast<Limb>(t);
+                carry = t >> 32;
+            }
+            r[i + b.size()] = static_cast<Limb>(carry);
+        }
+        trim(r);
+        return r;
+    }
+
+    // Karatsuba: three half-size products instead of four
+    static Magnitude mulMagnitude(const Magnitude& a, const Magnitude& b) {
+        if (a.empty() || b.empty()) {
+            return {};
+        }
+        if (a.size() < KARATSUBA_THRESHOLD || b.size() < KARATSUBA_THRESHOLD) {
+            return mulSchoolbook(a, b);
+        }
+
+        size_t half = std::max(a.size(), b.size()) / 2;
+        Magnitude a0 = slice(a, 0, half), a1 = slice(a, half, a.size());
+        Magnitude b0 = slice(b, 0, half), b1 = slice(b, half, b.size());
+
+        Magnitude z0 = mulMagnitude(a0, b0);
+        Magnitude z2 = mulMagnitude(a1, b1);
+        Magnitude z1 = mulMagnitude(addMagnitude(a0, a1), addMagnitude(b0, b1));
+        z1 = subMagnitude(subMagnitude(z1, z0), z2);
+
+        Magnitude r(a.size() + b.size() + 1, 0);
+        addShifted(r, z0, 0);
+        addShifted(r, z1, half);
+        addShifted(r, z2, 2 * half);
+        trim(r);
+        return r;
+    }
+
+    // m /= d in place, returning the remainder
+    static Limb divSmall(Magnitude& m, Limb d) {
+        uint64_t rem = 0;
+        for (size_t i = m.size(); i-- > 0;) {
+            uint64_t cur = (rem << 32) | m[i];
+            m[i] = static_cast<Limb>(cur / d);
+            rem = cur % d;
+        }
+        trim(m);
+        return static_cast<Limb>(rem);
+    }
+
+    // a mod b for b != 0 (Knuth, TAOCP vol. 2, 4.3.1, Algorithm D)
+    static Magnitude remMagnitude(const Magnitude& a, const Magnitude& b) {
+        if (compareMagnitude(a, b) < 0) {
+            return a;
+        }
+        if (b.size() == 1) {
+            Magnitude q = a;
+            Limb rem = divSmall(q, b[0]);
+            return rem == 0 ? Magnitude{} : Magnitude{ rem };
+        }
+
+        // Normalize so the divisor's top limb has its high bit set
+        int shift = 0;
+        for (Limb top = b.back(); (top & 0x80000000u) == 0; top <<= 1) {
+            shift++;
+        }
+        size_t n = b.size();
+        size_t m = a.size();
+        Magnitude v(n), u(m + 1);
+        for (size_t i = n; i-- > 1;) {
+            v[i] = static_cast<Limb>((static_cast<uint64_t>(b[i]) << shift) | (static_cast<uint64_t>(b[i - 1]) >> (32 - shift)));
+        }
+        v[0] = static_cast<Limb>(static_cast<uint64_t>(b[0]) << shift);
+        u[m] = static_cast<Limb>(static_cast<uint64_t>(a[m - 1]) >> (32 - shift));
+        for (size_t i = m; i-- > 1;) {
+            u[i] = static_cast<Limb>((static_cast<uint64_t>(a[i]) << shift) | (static_cast<uint64_t>(a[i - 1]) >> (32 - shift)));
+        }
+        u[0] = static_cast<Limb>(static_cast<uint64_t>(a[0]) << shift);
+
+        const uint64_t base = uint64_t(1) << 32;
+        for (size_t j = m - n + 1; j-- > 0;) {
+            uint64_t num = (static_cast<uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+            uint64_t qhat = num / v[n - 1];
+            uint64_t rhat = num % v[n - 1];
+            while (qhat >= base || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+                qhat--;
+                rhat += v[n - 1];
+                if (rhat >= base) {
+                    break;
+                }
+            }
+
+            // Multiply and subtract qhat * v from u[j .. j+n]
+            int64_t borrow = 0;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t p = qhat * v[i] + carry;
+                carry = p >> 32;
+                int64_t t = static_cast<int64_t>(u[i + j]) - static_cast<int64_t>(p & 0xFFFFFFFFu) - borrow;
+                borrow = t < 0 ? 1 : 0;
+                u[i + j] = static_cast<Limb>(t + (borrow << 32));
+            }
+            int64_t t = static_cast<int64_t>(u[j + n]) - static_cast<int64_t>(carry) - borrow;
+            u[j + n] = static_cast<Limb>(t);
+
+            // qhat was one too large: add the divisor back
+            if (t < 0) {
+                uint64_t c = 0;
+                for (size_t i = 0; i < n; i++) {
+                    uint64_t s = static_cast<uint64_t>(u[i + j]) + v[i] + c;
+                    u[i + j] = static_cast<Limb>(s);
+                    c = s >> 32;
+                }
+                u[j + n] = static_cast<Limb>(u[j + n] + c);
+            }
+        }
+
+        // Denormalize the remainder held in u[0 .. n-1]
+        Magnitude r(n);
+        for (size_t i = 0; i + 1 < n; i++) {
+            r[i] = static_cast<Limb>((static_cast<uint64_t>(u[i]) >> shift) | (static_cast<uint64_t>(u[i + 1]) << (32 - shift)));
+        }
+        r[n - 1] = static_cast<Limb>(static_cast<uint64_t>(u[n - 1]) >> shift);
+        trim(r);
+        return r;
+    }
+
+    static BigInt addSigned(const Magnitude& a, bool aNeg, const Magnitude& b, bool bNeg) {
+        if (aNeg == bNeg) {
+            return fromMagnitude(addMagnitude(a, b), aNeg);
+        }
+        if (compareMagnitude(a, b) >= 0) {
+            return fromMagnitude(subMagnitude(a, b), aNeg);
+        }
+        return fromMagnitude(subMagnitude(b, a), bNeg);
+    }
+
+public:
+    BigInt() : small(0), negative(false) {}
+    BigInt(int64_t v) : small(v), negative(false) {}
+
+    bool isZero() const { return isSmall() && small == 0; }
+    bool isNegative() const { return isSmall() ? small < 0 : negative; }
+    bool isOdd() const { return isSmall() ? (small & 1) != 0 : (limbs[0] & 1) != 0; }
+
+    friend bool operator==(const BigInt& a, const BigInt& b) {
+        return a.small == b.small && a.negative == b.negative && a.limbs == b.limbs;
+    }
+
+    friend bool operator!=(const BigInt& a, const BigInt& b) {
+        return !(a == b);
+    }
+
+    size_t hash() const {
+        size_t h = std::hash<int64_t>()(small) ^ (negative ? 0x9E3779B9u : 0u);
+        for (Limb l : limbs) {
+            h = h * 1000003 ^ l;
+        }
+        return h;
+    }
+
+    static BigInt add(const BigInt& a, const BigInt& b) {
+        int64_t r;
+        if (a.isSmall() && b.isSmall() && !addOverflow(a.small, b.small, r)) {
+            return BigInt(r);
+        }
+        return addSigned(a.magnitude(), a.isNegative(), b.magnitude(), b.isNegative());
+    }
+
+    static BigInt sub(const BigInt& a, const BigInt& b) {
+        int64_t r;
+        if (a.isSmall() && b.isSmall() && !subOverflow(a.small, b.small, r)) {
+            return BigInt(r);
+        }
+        return addSigned(a.magnitude(), a.isNegative(), b.magnitude(), !b.isNegative());
+    }
+
+    static BigInt mul(const BigInt& a, const BigInt& b) {
+        int64_t r;
+        if (a.isSmall() && b.isSmall() && !mulOverflow(a.small, b.small, r)) {
+            return BigInt(r);
+        }
+        Magnitude ma = a.magnitude();
+        Magnitude mb = b.magnitude();
+        if (bitLength(ma) + bitLength(mb) > MAX_BITS + 1) {
+            throw std::runtime_error("Integer too large");
+        }
+        return fromMagnitude(mulMagnitude(ma, mb), a.isNegative() != b.isNegative());
+    }
+
+    static BigInt mod(const BigInt& a, const BigInt& b) {
+        if (b.isZero()) {
+            throw std::runtime_error("Modulo by zero");
+        }
+        if (a.isSmall() && b.isSmall()) {
+            return BigInt(b.small == -1 ? 0 : a.small % b.small);
+        }
+        return fromMagnitude(remMagnitude(a.magnitude(), b.magnitude()), a.isNegative());
+    }
+
+    static BigInt pow(const BigInt& base, const BigInt& exponent) {
+        if (exponent.isNegative()) {
+            if (base.isZero()) {
+                throw std::runtime_error("Zero raised to a negative power");
+            }
+            if (base == BigInt(1) || base == BigInt(-1)) {
+                return exponent.isOdd() ? base : BigInt(1);
+            }
+            return BigInt(0);
+        }
+        if (exponent.isZero() || base == BigInt(1)) {
+            return BigInt(1);
+        }
+        if (base.isZero()) {
+            return BigInt(0);
+        }
+        if (base == BigInt(-1)) {
+            return exponent.isOdd() ? base : BigInt(1);
+        }
+
+        // |base| >= 2, so the result has at least exponent bits
+        size_t bits = base.bitWidth();
+        if (!exponent.isSmall() || static_cast<uint64_t>(exponent.small) > MAX_BITS / (bits - 1)) {
+            throw std::runtime_error("Integer too large");
+        }
+
+        int64_t e = exponent.small;
+        BigInt result(1);
+        BigInt factor = base;
+        for (;;) {
+            if (e & 1) {
+                result = mul(result, factor);
+            }
+            e >>= 1;
+            if (e == 0) {
+                return result;
+            }
+            factor = mul(factor, factor);
+        }
+    }
+
+    // Rough cost of a op b in execution-budget steps (about one node
+    // evaluation each), estimated from operand widths before the operation
+    // runs. Operations that will be rejected for size cost nothing extra.
+    static uint64_t cost(char op, const BigInt& a, const BigInt& b) {
+        uint64_t la = a.isSmall() ? 2 : a.limbs.size();
+        uint64_t lb = b.isSmall() ? 2 : b.limbs.size();
+        switch (op) {
+        case '+':
+        case '-':
+            return (la + lb) / 64;
+        case '*':
+        case '%':
+            return la * lb / 64;
+        case '^': {
+            if (!b.isSmall() || b.small < 2) {
+                return 0;
+            }
+            uint64_t bits = a.bitWidth();
+            if (bits < 2 || (bits - 1) * static_cast<uint64_t>(b.small) > MAX_BITS) {
+                return 0;
+            }
+            uint64_t resultLimbs = bits * static_cast<uint64_t>(b.small) / 32 + 1;
+            return resultLimbs * resultLimbs / 64;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    std::string toString() const {
+        if (isSmall()) {
+            return std::to_string(small);
+        }
+        // Peel off base-10^9 chunks, least significant first
+        Magnitude m = limbs;
+        std::vector<Limb> chunks;
+        while (!m.empty()) {
+            chunks.push_back(divSmall(m, 1000000000u));
+        }
+        std::string out = negative ? "-" : "";
+        out += std::to_string(chunks.back());
+        for (size_t i = chunks.size() - 1; i-- > 0;) {
+            std::string digits = std::to_string(chunks[i]);
+            out.append(9 - digits.size(), '0');
+            out += digits;
+        }
+        return out;
+    }
+};
+
+// a op b into out for a backend whose + - * wrap, with ^ and % checked; the
+// error otherwise. Backends provide this as tryApply.
+template <typename Backend, typename Value>
+inline GlyphError applyStatus(char op, Value a, Value b, Value& out) {
+    switch (op) {
+    case '+': out = Backend::add(a, b); return GlyphError::NONE;
+    case '-': out = Backend::sub(a, b); return GlyphError::NONE;
+    case '*': out = Backend::mul(a, b); return GlyphError::NONE;
+    case '^': return powStatus(a, b, out);
+    case '%': return modStatus(a, b, out);
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+}
+
+// A numeric backend supplies the value type and the operator semantics the
+// evaluator is instantiated with. Int32Backend is the historical behavior and
+// the one the bytecode VM implements: + - * wrap modulo 2^32.
+struct Int32Backend {
+    using Value = int;
+    static Value unit() { return 1; }
+    static Value fromInt(int v) { return v; }
+    static bool isZero(Value v) { return v == 0; }
+    static Value add(Value a, Value b) { return static_cast<Value>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+    static Value sub(Value a, Value b) { return static_cast<Value>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+    static Value mul(Value a, Value b) { return static_cast<Value>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+    static Value pow(Value a, Value b) { return powInt(a, b); }
+    static Value mod(Value a, Value b) { return modInt(a, b); }
+    static GlyphError tryApply(char op, Value a, Value b, Value& out) { return applyStatus<Int32Backend>(op, a, b, out); }
+    static constexpr uint64_t cost(char, Value, Value) { return 0; }
+    static size_t hash(Value v) { return std::hash<Value>()(v); }
+    static std::string toString(Value v) { return std::to_string(v); }
+};
+
+// 64-bit two's complement arithmetic that wraps on overflow
+struct Int64Backend {
+    using Value = int64_t;
+    static Value unit() { return 1; }
+    static Value fromInt(int v) { return v; }
+    static bool isZero(Value v) { return v == 0; }
+    static Value add(Value a, Value b) { return static_cast<Value>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }
+    static Value sub(Value a, Value b) { return static_cast<Value>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); }
+    static Value mul(Value a, Value b) { return static_cast<Value>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }
+    static Value pow(Value a, Value b) { return powChecked(a, b); }
+    static Value mod(Value a, Value b) { return modChecked(a, b); }
+    static GlyphError tryApply(char op, Value a, Value b, Value& out) { return applyStatus<Int64Backend>(op, a, b, out); }
+    static constexpr uint64_t cost(char, Value, Value) { return 0; }
+    static size_t hash(Value v) { return std::hash<Value>()(v); }
+    static std::string toString(Value v) { return std::to_string(v); }
+};
+
+// 64-bit arithmetic that reports overflow instead of wrapping
+struct CheckedInt64Backend : Int64Backend {
+    static Value add(Value a, Value b) {
+        Value r;
+        if (addOverflow(a, b, r)) {
+            throw std::runtime_error("Integer overflow in '+'");
+        }
+        return r;
+    }
+    static Value sub(Value a, Value b) {
+        Value r;
+        if (subOverflow(a, b, r)) {
+            throw std::runtime_error("Integer overflow in '-'");
+        }
+        return r;
+    }
+    static Value mul(Value a, Value b) {
+        Value r;
+        if (mulOverflow(a, b, r)) {
+            throw std::runtime_error("Integer overflow in '*'");
+        }
+        return r;
+    }
+    static GlyphError tryApply(char op, Value a, Value b, Value& out) {
+        bool overflow;
+        switch (op) {
+        case '+': overflow = addOverflow(a, b, out); break;
+        case '-': overflow = subOverflow(a, b, out); break;
+        case '*': overflow = mulOverflow(a, b, out); break;
+        default: return applyStatus<Int64Backend>(op, a, b, out);
+        }
+        return overflow ? GlyphError::INTEGER_OVERFLOW : GlyphError::NONE;
+    }
+};
+
+struct BigIntBackend {
+    using Value = BigInt;
+    static Value unit() { return BigInt(1); }
+    static Value fromInt(int v) { return BigInt(v); }
+    static bool isZero(const Value& v) { return v.isZero(); }
+    static Value add(const Value& a, const Value& b) { return BigInt::add(a, b); }
+    static Value sub(const Value& a, const Value& b) { return BigInt::sub(a, b); }
+    static Value mul(const Value& a, const Value& b) { return BigInt::mul(a, b); }
+    static Value pow(const Value& a, const Value& b) { return BigInt::pow(a, b); }
+    static Value mod(const Value& a, const Value& b) { return BigInt::mod(a, b); }
+    // Only an oversized result still throws inside BigInt
+    static GlyphError tryApply(char op, const Value& a, const Value& b, Value& out) {
+        if (op == '%' && b.isZero()) {
+            return GlyphError::MODULO_BY_ZERO;
+        }
+        if (op == '^' && a.isZero() && b.isNegative()) {
+            return GlyphError::ZERO_NEGATIVE_POWER;
+        }
+        try {
+            out = applyThrowing(op, a, b);
+        }
+        catch (const std::runtime_error&) {
+            return GlyphError::INTEGER_TOO_LARGE;
+        }
+        return GlyphError::NONE;
+    }
+    static Value applyThrowing(char op, const Value& a, const Value& b) {
+        switch (op) {
+        case '+': return add(a, b);
+        case '-': return sub(a, b);
+        case '*': return mul(a, b);
+        case '^': return pow(a, b);
+        case '%': return mod(a, b);
+        default:
+            throw std::runtime_error("Unknown operator");
+        }
+    }
+    static uint64_t cost(char op, const Value& a, const Value& b) { return BigInt::cost(op, a, b); }
+    static size_t hash(const Value& v) { return v.hash(); }
+    static std::string toString(const Value& v) { return v.toString(); }
+};
+
+// Run-time choice of backend for GlyphInterpreter::runAs
+enum class NumericBackend {
+    INT32,
+    INT64,
+    CHECKED_INT64,
+    BIGINT
+};
+
+inline constexpr size_t NUMERIC_BACKEND_COUNT = 4;
+
+inline bool parseNumericBackend(const std::string& name, NumericBackend& backend) {
+    if (name == "int32") backend = NumericBackend::INT32;
+    else if (name == "int64") backend = NumericBackend::INT64;
+    else if (name == "checked-int64") backend = NumericBackend::CHECKED_INT64;
+    else if (name == "bigint") backend = NumericBackend::BIGINT;
+    else return false;
+    return true;
+}
+
+// ============================================================================
+// Execution Budget
+// ============================================================================
+
+// Raised when a program runs out of steps or time. Both derive from
+// std::runtime_error, so callers that only report messages need no change.
+class StepLimitExceeded : public std::runtime_error {
+public:
+    StepLimitExceeded() : std::runtime_error("Step limit exceeded") {}
+};
+
+class DeadlineExceeded : public std::runtime_error {
+public:
+    DeadlineExceeded() : std::runtime_error("Deadline exceeded") {}
+};
+
+// Per-evaluation limits; 0 means unlimited
+struct ExecutionLimits {
+    uint64_t maxSteps = 0;              // node evaluations / instructions
+    std::chrono::nanoseconds timeout{ 0 }; // wall clock from the start of evaluation
+
+    bool unlimited() const { return maxSteps == 0 && timeout.count() == 0; }
+};
+
+// Step and deadline accounting for one evaluation. Steps are handed out in
+// slices: charge() only decrements the current slice, and the clock is read
+// when a slice runs out, so the hot loop pays one subtract and branch per
+// step. Without limits the slice never runs out.
+class ExecutionBudget {
+private:
+    static constexpr uint64_t SLICE = 4096;
+
+    uint64_t left;     // steps left in the current slice
+    uint64_t reserve;  // steps not yet handed out
+    bool stepLimited;
+    bool timed;
+    std::chrono::steady_clock::time_point deadline;
+
+    GlyphError refill(uint64_t steps) {
+        if (timed && std::chrono::steady_clock::now() >= deadline) {
+            return GlyphError::DEADLINE;
+        }
+        if (!stepLimited) {
+            left = SLICE;
+            return GlyphError::NONE;
+        }
+        if (steps > left + reserve) {
+            return GlyphError::STEP_LIMIT;
+        }
+        uint64_t fromReserve = steps - left;
+        reserve -= fromReserve;
+        left = std::min(SLICE, reserve);
+        reserve -= left;
+        return GlyphError::NONE;
+    }
+
+public:
+    explicit ExecutionBudget(const ExecutionLimits& limits)
+        : left(UINT64_MAX), reserve(0), stepLimited(limits.maxSteps != 0), timed(limits.timeout.count() != 0) {
+        if (timed) {
+            deadline = std::chrono::steady_clock::now() + limits.timeout;
+            left = SLICE;
+        }
+        if (stepLimited) {
+            left = std::min(SLICE, limits.maxSteps);
+            reserve = limits.maxSteps - left;
+        }
+    }
+
+    // True if any limit is set, i.e. charges can fail
+    bool limited() const { return stepLimited || timed; }
+
+    void charge(uint64_t steps = 1) {
+        if (steps < left) {
+            left -= steps;
+            return;
+        }
+        GlyphError error = refill(steps);
+        if (error == GlyphError::DEADLINE) {
+            throw DeadlineExceeded();
+        }
+        if (error == GlyphError::STEP_LIMIT) {
+            throw StepLimitExceeded();
+        }
+    }
+
+    // charge() that returns STEP_LIMIT or DEADLINE instead of throwing
+    GlyphError tryCharge(uint64_t steps = 1) {
+        if (steps < left) {
+            left -= steps;
+            return GlyphError::NONE;
+        }
+        return refill(steps);
+    }
+};
+
+// ============================================================================
+// Run Statistics
+// ============================================================================
+
+// Counters collected by GlyphInterpreter when stats are on (setStats). The
+// evaluator fills its part only in its instrumented instantiation, so runs
+// without stats execute no counting code at all.
+struct RunStats {
+    static constexpr size_t NODE_TYPES = 6;
+    static constexpr size_t OPERATORS = 5;
+    static constexpr char OPERATOR_CHARS[OPERATORS + 1] = "+-*^%";
+
+    uint64_t programs = 0;
+    uint64_t failures = 0;
+
+    // Wall time per phase, summed over programs
+    double validateNs = 0;
+    double parseNs = 0;
+    double optimizeNs = 0;
+    double evaluateNs = 0;
+
+    uint64_t parsedNodes[NODE_TYPES] = {};    // AST nodes as parsed, by NodeType
+    uint64_t evaluatedNodes[NODE_TYPES] = {}; // node evaluations, by NodeType
+    uint64_t operatorEvaluations[OPERATORS] = {};
+
+    size_t maxNesting = 0;   // deepest bracket nesting in the source
+    size_t maxEvalDepth = 0; // deepest evaluator work stack
+
+    uint64_t binds = 0;      // let frames pushed
+    uint64_t bindBytes = 0;  // bytes written for those frames
+
+    static int operatorIndex(char op) {
+        switch (op) {
+        case '+': return 0;
+        case '-': return 1;
+        case '*': return 2;
+        case '^': return 3;
+        case '%': return 4;
+        default: return -1;
+        }
+    }
+
+    static const char* nodeTypeName(size_t type) {
+        static const char* const names[NODE_TYPES] = { "value", "binary", "let", "cond", "var", "const" };
+        return type < NODE_TYPES ? names[type] : "?";
+    }
+
+    void merge(const RunStats& o) {
+        programs += o.programs;
+        failures += o.failures;
+        validateNs += o.validateNs;
+        parseNs += o.parseNs;
+        optimizeNs += o.optimizeNs;
+        evaluateNs += o.evaluateNs;
+        for (size_t i = 0; i < NODE_TYPES; i++) {
+            parsedNodes[i] += o.parsedNodes[i];
+            evaluatedNodes[i] += o.evaluatedNodes[i];
+        }
+        for (size_t i = 0; i < OPERATORS; i++) {
+            operatorEvaluations[i] += o.operatorEvaluations[i];
+        }
+        maxNesting = std::max(maxNesting, o.maxNesting);
+        maxEvalDepth = std::max(maxEvalDepth, o.maxEvalDepth);
+        binds += o.binds;
+        bindBytes += o.bindBytes;
+    }
+};
+
+// Adds the nodes of the tree rooted at root to counts, by NodeType. Shared
+// subtrees are counted once per path, as a parsed tree has none.
+inline void countNodes(const ASTNode& root, uint64_t counts[RunStats::NODE_TYPES]) {
+    std::vector<const ASTNode*> stack{ &root };
+    while (!stack.empty()) {
+        const ASTNode* node = stack.back();
+        stack.pop_back();
+        counts[static_cast<size_t>(node->type)]++;
+        const ASTNode* kids[3];
+        int count = astChildren(node, kids);
+        stack.insert(stack.end(), kids, kids + count);
+    }
+}
+
+// ============================================================================
+// Evaluator
+// ============================================================================
+
+// Tree-walking evaluator driven by an explicit work stack. Each task is a node
+// plus how far its evaluation has progressed; operands accumulate on a value
+// stack. Let frames live in a deque so their addresses stay valid while inner
+// bindings point at them. Arithmetic comes from the numeric Backend.
+//
+// With memoization on, shared subtrees of a hash-consed DAG are evaluated
+// once per distinct set of values of the variables they can read; later
+// evaluations are table lookups. The table is keyed on node addresses and
+// kept across calls with the same root, so clearMemo() must be called
+// before that tree is released.
+//
+// The Instrumented instantiation also counts node and operator evaluations,
+// let binds and the deepest work stack into stats().
+template <typename Backend, bool Instrumented = false>
+class BasicEvaluator {
+public:
+    using Value = typename Backend::Value;
+    using Env = BasicEnvironment<Value>;
+
+private:
+    struct Task {
+        const ASTNode* node;
+        int stage;
+    };
+
+    // A shared subtree worth remembering: its estimated cost (see nodeCost)
+    // and the variables it may read
+    struct MemoPlan {
+        size_t cost;
+        std::vector<int> vars;
+    };
+
+    struct MemoKey {
+        const ASTNode* node;
+        std::vector<Value> vars; // values of the plan's variables, in order
+
+        bool operator==(const MemoKey& o) const {
+            return node == o.node && vars == o.vars;
+        }
+    };
+
+    struct MemoKeyHash {
+        size_t operator()(const MemoKey& k) const {
+            size_t h = std::hash<const void*>()(k.node);
+            for (const Value& v : k.vars) {
+                h = h * 1000003 ^ Backend::hash(v);
+            }
+            return h;
+        }
+    };
+
+    // Task stages used by memoization: evaluate a node without looking it
+    // up, and store a finished node's value
+    static constexpr int MEMO_EVAL = -2;
+    static constexpr int MEMO_STORE = -1;
+
+    // Subtrees cheaper than this are recomputed rather than looked up
+    static constexpr size_t MEMO_MIN_COST = 16;
+
+    // Rough cost of evaluating one node: '^' and '*' can be far more
+    // expensive than a table lookup even on small operands
+    static size_t nodeCost(const ASTNode* node) {
+        if (node->type != NodeType::BINARY_OP) {
+            return 1;
+        }
+        switch (static_cast<const BinaryOpNode*>(node)->op) {
+        case '^': return MEMO_MIN_COST;
+        case '*': return 4;
+        default: return 1;
+        }
+    }
+
+    // Subtrees that may read more variables than this are not memoized
+    static constexpr size_t MEMO_MAX_VARS = 8;
+
+    std::vector<Task> tasks;
+    std::vector<Value> values;
+    std::deque<Env> frames; // only grows; the first openFrames are in use
+    size_t openFrames = 0;
+
+    bool memoEnabled = false;
+    const ASTNode* memoRoot = nullptr;
+    std::unordered_map<const ASTNode*, MemoPlan> memoPlans;
+    std::unordered_map<MemoKey, Value, MemoKeyHash> memo;
+    std::vector<MemoKey> pendingKeys;
+    size_t memoHits = 0;
+    size_t memoNodes = 0;
+
+    RunStats counters;
+    ExecutionLimits limits;
+
+    // Finds the subtrees reachable from root along more than one path and
+    // the variables each may read
+    void planMemo(const ASTNode& root) {
+        struct Summary {
+            size_t parents = 0;
+            size_t cost = 0;
+            bool tooManyVars = false;
+            std::vector<int> vars; // sorted
+        };
+
+        // Post-order over the DAG; a node is expanded on its first visit, and
+        // the stack discipline finishes its children before it.
+        std::unordered_map<const ASTNode*, Summary> seen;
+        std::vector<std::pair<const ASTNode*, bool>> stack;
+        stack.push_back({ &root, false });
+
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+            const ASTNode* kids[3];
+            int count = astChildren(node, kids);
+            Summary& s = seen[node];
+
+            if (!expanded) {
+                if (s.parents++ == 0) {
+                    stack.push_back({ node, true });
+                    for (int i = 0; i < count; i++) {
+                        stack.push_back({ kids[i], false });
+                    }
+                }
+                continue;
+            }
+
+            s.cost = nodeCost(node);
+            if (node->type == NodeType::VAR) {
+                s.vars.push_back(static_cast<const VarNode*>(node)->varIndex);
+            }
+            for (int i = 0; i < count; i++) {
+                const Summary& c = seen[kids[i]];
+                s.cost = std::min(s.cost + c.cost, SIZE_MAX / 4);
+                if (s.tooManyVars || c.tooManyVars) {
+                    s.tooManyVars = true;
+                    continue;
+                }
+                std::vector<int> merged;
+                std::set_union(s.vars.begin(), s.vars.end(), c.vars.begin(), c.vars.end(), std::back_inserter(merged));
+                s.vars = std::move(merged);
+                if (s.vars.size() > MEMO_MAX_VARS) {
+                    s.tooManyVars = true;
+                    s.vars.clear();
+                }
+            }
+        }
+
+        memoPlans.clear();
+        for (auto& [node, s] : seen) {
+            if (s.parents > 1 && s.cost >= MEMO_MIN_COST && !s.tooManyVars) {
+                memoPlans.emplace(node, MemoPlan{ s.cost, std::move(s.vars) });
+            }
+        }
+    }
+
+    // Called as the task at index top starts on node. Returns true if the
+    // memo handled it: either its value was pushed, or the task now stores
+    // the value once the node (pushed on top) has been evaluated.
+    bool recall(const ASTNode* node, const Env& env, size_t top) {
+        auto plan = memoPlans.find(node);
+        if (plan == memoPlans.end()) {
+            return false;
+        }
+
+        MemoKey key{ node, {} };
+        key.vars.reserve(plan->second.vars.size());
+        for (int var : plan->second.vars) {
+            const Value* value = env.lookup(Backend::fromInt(var));
+            if (value == nullptr) {
+                return false; // evaluate normally and report the unbound name
+            }
+            key.vars.push_back(*value);
+        }
+
+        auto it = memo.find(key);
+        if (it != memo.end()) {
+            values.push_back(it->second);
+            tasks.pop_back();
+            memoHits++;
+            memoNodes += plan->second.cost;
+            return true;
+        }
+        pendingKeys.push_back(std::move(key));
+        tasks[top].stage = MEMO_STORE;
+        tasks.push_back({ node, MEMO_EVAL });
+        return true;
+    }
+
+    Value pop() {
+        Value v = std::move(values.back());
+        values.pop_back();
+        return v;
+    }
+
+    // One stage of a binary node; Kind fixes the operator, so each operator
+    // is its own case in evaluate's switch with its kernel inlined
+    template <NodeKind Kind>
+    void binary(const ASTNode* node, int stage, ExecutionBudget& budget) {
+        const auto* bin = static_cast<const BinaryOpNode*>(node);
+        if (stage < 2) {
+            tasks.push_back({ stage == 0 ? bin->left : bin->right, 0 });
+            return;
+        }
+        Value rightVal = pop();
+        Value& leftVal = values.back();
+        if constexpr (Instrumented) {
+            int op = RunStats::operatorIndex(bin->op);
+            if (op >= 0) {
+                counters.operatorEvaluations[op]++;
+            }
+        }
+        if (budget.limited()) {
+            budget.charge(Backend::cost(bin->op, leftVal, rightVal));
+        }
+        leftVal = apply<Kind>(leftVal, rightVal);
+        tasks.pop_back();
+    }
+
+public:
+    // The kernel of a binary node of kind Kind
+    template <NodeKind Kind>
+    static Value apply(const Value& leftVal, const Value& rightVal) {
+        if constexpr (Kind == NodeKind::ADD) {
+            return Backend::add(leftVal, rightVal);
+        }
+        else if constexpr (Kind == NodeKind::SUB) {
+            return Backend::sub(leftVal, rightVal);
+        }
+        else if constexpr (Kind == NodeKind::MUL) {
+            return Backend::mul(leftVal, rightVal);
+        }
+        else if constexpr (Kind == NodeKind::POW) {
+            return Backend::pow(leftVal, rightVal);
+        }
+        else if constexpr (Kind == NodeKind::MOD) {
+            return Backend::mod(leftVal, rightVal);
+        }
+        else {
+            throw std::runtime_error("Unknown operator");
+        }
+    }
+
+    // Remember shared subtrees' values (off by default)
+    void setMemoize(bool enabled) {
+        memoEnabled = enabled;
+    }
+
+    // Forget all memoized values, e.g. before the tree they refer to is freed
+    void clearMemo() {
+        memoRoot = nullptr;
+        memoPlans.clear();
+        memo.clear();
+    }
+
+    // Subtree evaluations answered from the memo since construction
+    size_t memoizedEvaluations() const { return memoHits; }
+
+    // Estimated cost those lookups replaced, roughly in node evaluations
+    size_t memoizedNodes() const { return memoNodes; }
+
+    // Evaluation counters since construction (Instrumented only)
+    const RunStats& stats() const { return counters; }
+
+    // Step and time limits applied to each evaluate() call
+    void setLimits(const ExecutionLimits& l) {
+        limits = l;
+    }
+
+    Value evaluate(const ASTNode& root, const Env& env) {
+        tasks.clear();
+        values.clear();
+        openFrames = 0;
+        pendingKeys.clear();
+
+        if (memoEnabled && memoRoot != &root) {
+            clearMemo();
+            planMemo(root);
+            memoRoot = &root;
+        }
+        bool memoActive = memoEnabled && !memoPlans.empty();
+
+        const Env* current = &env;
+        ExecutionBudget budget(limits);
+        tasks.push_back({ &root, 0 });
+
+        while (!tasks.empty()) {
+            budget.charge();
+            size_t top = tasks.size() - 1;
+            const ASTNode* node = tasks[top].node;
+            int stage = tasks[top].stage++;
+
+            if (stage == MEMO_STORE) {
+                memo.emplace(std::move(pendingKeys.back()), values.back());
+                pendingKeys.pop_back();
+                tasks.pop_back();
+                continue;
+            }
+            if (stage == MEMO_EVAL) {
+                stage = 0;
+                tasks[top].stage = 1;
+            }
+            else if (stage == 0 && memoActive && recall(node, *current, top)) {
+                continue;
+            }
+            if constexpr (Instrumented) {
+                if (stage == 0) {
+                    counters.evaluatedNodes[static_cast<size_t>(node->type)]++;
+                    counters.maxEvalDepth = std::max(counters.maxEvalDepth, tasks.size());
+                }
+            }
+
+            switch (node->kind) {
+            case NodeKind::UNIT:
+                values.push_back(Backend::unit());
+                tasks.pop_back();
+                break;
+
+            case NodeKind::CONST:
+                values.push_back(Backend::fromInt(static_cast<const ConstNode*>(node)->value));
+                tasks.pop_back();
+                break;
+
+            case NodeKind::VAR: {
+                int varIndex = static_cast<const VarNode*>(node)->varIndex;
+                const Value* value = current->lookup(Backend::fromInt(varIndex));
+                if (value == nullptr) {
+                    throw std::runtime_error("Unbound variable: " + std::to_string(varIndex));
+                }
+                values.push_back(*value);
+                tasks.pop_back();
+                break;
+            }
+
+            case NodeKind::ADD:
+                binary<NodeKind::ADD>(node, stage, budget);
+                break;
+            case NodeKind::SUB:
+                binary<NodeKind::SUB>(node, stage, budget);
+                break;
+            case NodeKind::MUL:
+                binary<NodeKind::MUL>(node, stage, budget);
+                break;
+            case NodeKind::POW:
+                binary<NodeKind::POW>(node, stage, budget);
+                break;
+            case NodeKind::MOD:
+                binary<NodeKind::MOD>(node, stage, budget);
+                break;
+            case NodeKind::OTHER_OP:
+                binary<NodeKind::OTHER_OP>(node, stage, budget);
+                break;
+
+            case NodeKind::LET: {
+                // Value first, then name, both in the enclosing scope; the
+                // body sees the new binding.
+                const auto* let = static_cast<const LetNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ let->value, 0 });
+                }
+                else if (stage == 1) {
+                    tasks.push_back({ let->name, 0 });
+                }
+                else if (stage == 2) {
+                    Value varIndex = pop(); // Use evaluated name as index
+                    Value val = pop();
+                    if (openFrames == frames.size()) {
+                        frames.emplace_back(*current, std::move(varIndex), std::move(val));
+                    }
+                    else {
+                        frames[openFrames] = Env(*current, std::move(varIndex), std::move(val));
+                    }
+                    current = &frames[openFrames++];
+                    if constexpr (Instrumented) {
+                        counters.binds++;
+                        counters.bindBytes += sizeof(Env);
+                    }
+                    tasks.push_back({ let->body, 0 });
+                }
+                else {
+                    openFrames--;
+                    current = openFrames == 0 ? &env : &frames[openFrames - 1];
+                    tasks.pop_back();
+                }
+                break;
+            }
+
+            case NodeKind::COND: {
+                // condVal == 0 -> else, otherwise -> then
+                const auto* cond = static_cast<const CondNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ cond->condition, 0 });
+                }
+                else if (stage == 1) {
+                    Value condVal = pop();
+                    tasks.push_back({ Backend::isZero(condVal) ? cond->elseBranch : cond->thenBranch, 0 });
+                }
+                else {
+                    tasks.pop_back();
+                }
+                break;
+            }
+            }
+        }
+
+        return std::move(values.back());
+    }
+};
+
+using Evaluator = BasicEvaluator<Int32Backend>;
+
+inline int ASTNode::evaluate(const Environment& env) const {
+    Evaluator evaluator;
+    return evaluator.evaluate(*this, env);
+}
+
+// ============================================================================
+// Optimizer
+// ============================================================================
+
+// Folds constant subtrees and hash-conses the rest into a DAG. A subtree is
+// folded only when every operation in it is exact in int (no overflow, no
+// modulo by zero), so the folded value is the same under every numeric
+// backend and any error is still raised at run time. A conditional whose
+// condition is constant is replaced by the branch it selects. Like the
+// Evaluator, the pass walks the tree with an explicit work stack.
+class Optimizer {
+private:
+    struct Task {
+        const ASTNode* node;
+        int stage;
+    };
+
+    struct Result {
+        const ASTNode* node;
+        bool isConst;
+        int value;
+    };
+
+    // Compile-time view of a let binding, used to resolve VarNodes
+    struct Scope {
+        bool nameKnown;
+        int name;
+        bool valueKnown;
+        int value;
+    };
+
+    struct NodeKey {
+        NodeType type;
+        char op;
+        int value;
+        const ASTNode* a;
+        const ASTNode* b;
+        const ASTNode* c;
+
+        bool operator==(const NodeKey& o) const {
+            return type == o.type && op == o.op && value == o.value && a == o.a && b == o.b && c == o.c;
+        }
+    };
+
+    struct NodeKeyHash {
+        size_t operator()(const NodeKey& k) const {
+            size_t h = static_cast<size_t>(k.type) * 31 + static_cast<unsigned char>(k.op);
+            h = h * 1000003 ^ std::hash<int>()(k.value);
+            h = h * 1000003 ^ std::hash<const void*>()(k.a);
+            h = h * 1000003 ^ std::hash<const void*>()(k.b);
+            h = h * 1000003 ^ std::hash<const void*>()(k.c);
+            return h;
+        }
+    };
+
+    // Stages of a conditional whose condition folded to a constant
+    static constexpr int COND_SELECTED = 100;
+
+    // Open-addressed table of the nodes built by this run. A slot belongs to
+    // the run whose number it carries, so starting a run empties the table
+    // without touching it, and its storage is reused from run to run.
+    struct InternSlot {
+        NodeKey key;
+        const ASTNode* node;
+        uint32_t run;
+    };
+
+    static constexpr size_t MIN_INTERN_SLOTS = 64;
+
+    Arena* arena = nullptr;
+    std::vector<Task> tasks;
+    std::vector<Result> results;
+    std::vector<Scope> scopes;
+    std::vector<InternSlot> interned; // size is a power of two
+    size_t internedCount = 0;
+    uint32_t run = 0;
+
+    size_t folded = 0;
+    size_t shared = 0;
+
+    void startRun() {
+        internedCount = 0;
+        if (++run == 0) {
+            for (InternSlot& slot : interned) {
+                slot.run = 0;
+            }
+            run = 1;
+        }
+    }
+
+    InternSlot& slotFor(const NodeKey& key) {
+        size_t mask = interned.size() - 1;
+        for (size_t i = NodeKeyHash()(key) & mask;; i = (i + 1) & mask) {
+            InternSlot& slot = interned[i];
+            if (slot.run != run || slot.key == key) {
+                return slot;
+            }
+        }
+    }
+
+    // Keeps the table at most half full
+    void reserveSlot() {
+        if ((internedCount + 1) * 2 <= interned.size()) {
+            return;
+        }
+        std::vector<InternSlot> old;
+        old.swap(interned);
+        interned.assign(std::max(MIN_INTERN_SLOTS, old.size() * 2), InternSlot{ {}, nullptr, 0 });
+        for (const InternSlot& slot : old) {
+            if (slot.run == run) {
+                slotFor(slot.key) = slot;
+            }
+        }
+    }
+
+    Result pop() {
+        Result r = results.back();
+        results.pop_back();
+        return r;
+    }
+
+    template <typename T, typename... Args>
+    const ASTNode* intern(const NodeKey& key, Args&&... args) {
+        reserveSlot();
+        InternSlot& slot = slotFor(key);
+        if (slot.run == run) {
+            shared++;
+            return slot.node;
+        }
+        const ASTNode* node = arena->make<T>(std::forward<Args>(args)...);
+        slot = { key, node, run };
+        internedCount++;
+        return node;
+    }
+
+    Result constant(int value) {
+        const ASTNode* node = value == 1
+            ? static_cast<const ASTNode*>(ValueNode::instance())
+            : intern<ConstNode>({ NodeType::CONST, 0, value, nullptr, nullptr, nullptr }, value);
+        return { node, true, value };
+    }
+
+    // Exact int result of op, or false if it overflows or is undefined
+    static bool foldBinary(char op, int l, int r, int& out) {
+        switch (op) {
+        case '+': return !addOverflow(l, r, out);
+        case '-': return !subOverflow(l, r, out);
+        case '*': return !mulOverflow(l, r, out);
+        case '^': return powStatus(l, r, out) == GlyphError::NONE;
+        case '%': return modStatus(l, r, out) == GlyphError::NONE;
+        default:
+            return false;
+        }
+    }
+
+    Result resolveVar(const VarNode* var) {
+        for (size_t i = scopes.size(); i-- > 0;) {
+            const Scope& s = scopes[i];
+            if (!s.nameKnown) {
+                break; // a computed name could shadow anything
+            }
+            if (s.name == var->varIndex) {
+                if (s.valueKnown) {
+                    folded++;
+                    return constant(s.value);
+                }
+                break;
+            }
+        }
+        return { intern<VarNode>({ NodeType::VAR, 0, var->varIndex, nullptr, nullptr, nullptr }, var->varIndex), false, 0 };
+    }
+
+public:
+    // Rewrites the tree rooted at root; new nodes are allocated from nodes
+    const ASTNode* optimize(const ASTNode* root, Arena& nodes) {
+        arena = &nodes;
+        tasks.clear();
+        results.clear();
+        scopes.clear();
+        startRun();
+        folded = 0;
+        shared = 0;
+
+        tasks.push_back({ root, 0 });
+
+        while (!tasks.empty()) {
+            size_t top = tasks.size() - 1;
+            const ASTNode* node = tasks[top].node;
+            int stage = tasks[top].stage++;
+
+            switch (node->type) {
+            case NodeType::VALUE:
+                results.push_back({ node, true, 1 });
+                tasks.pop_back();
+                break;
+
+            case NodeType::CONST:
+                results.push_back(constant(static_cast<const ConstNode*>(node)->value));
+                tasks.pop_back();
+                break;
+
+            case NodeType::VAR:
+                results.push_back(resolveVar(static_cast<const VarNode*>(node)));
+                tasks.pop_back();
+                break;
+
+            case NodeType::BINARY_OP: {
+                const auto* bin = static_cast<const BinaryOpNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ bin->left, 0 });
+                    break;
+                }
+                if (stage == 1) {
+                    tasks.push_back({ bin->right, 0 });
+                    break;
+                }
+                Result right = pop();
+                Result left = pop();
+                int value;
+                if (left.isConst && right.isConst && foldBinary(bin->op, left.value, right.value, value)) {
+                    folded++;
+                    results.push_back(constant(value));
+                }
+                else {
+                    results.push_back({ intern<BinaryOpNode>(
+                        { NodeType::BINARY_OP, bin->op, 0, left.node, right.node, nullptr },
+                        bin->op, left.node, right.node), false, 0 });
+                }
+                tasks.pop_back();
+                break;
+            }
+
+            case NodeType::LET: {
+                const auto* let = static_cast<const LetNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ let->value, 0 });
+                }
+                else if (stage == 1) {
+                    tasks.push_back({ let->name, 0 });
+                }
+                else if (stage == 2) {
+                    const Result& name = results[results.size() - 1];
+                    const Result& value = results[results.size() - 2];
+                    scopes.push_back({ name.isConst, name.value, value.isConst, value.value });
+                    tasks.push_back({ let->body, 0 });
+                }
+                else {
+                    scopes.pop_back();
+                    Result body = pop();
+                    Result name = pop();
+                    Result value = pop();
+                    // Binding a constant can neither fail nor be observed
+                    // once the body is constant too.
+                    if (name.isConst && value.isConst && body.isConst) {
+                        folded++;
+                        results.push_back(body);
+                    }
+                    else {
+                        results.push_back({ intern<LetNode>(
+                            { NodeType::LET, 0, 0, name.node, value.node, body.node },
+                            name.node, value.node, body.node), false, 0 });
+                    }
+                    tasks.pop_back();
+                }
+                break;
+            }
+
+            case NodeType::COND: {
+                const auto* cond = static_cast<const CondNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ cond->condition, 0 });
+                }
+                else if (stage == 1) {
+                    if (results.back().isConst) {
+                        // Drop the dead branch; the live one is the result
+                        Result c = pop();
+                        folded++;
+                        tasks[top].stage = COND_SELECTED;
+                        tasks.push_back({ c.value == 0 ? cond->elseBranch : cond->thenBranch, 0 });
+                    }
+                    else {
+                        tasks.push_back({ cond->thenBranch, 0 });
+                    }
+                }
+                else if (stage == 2) {
+                    tasks.push_back({ cond->elseBranch, 0 });
+                }
+                else if (stage == COND_SELECTED) {
+                    tasks.pop_back();
+                }
+                else {
+                    Result elseBranch = pop();
+                    Result thenBranch = pop();
+                    Result c = pop();
+                    results.push_back({ intern<CondNode>(
+                        { NodeType::COND, 0, 0, c.node, thenBranch.node, elseBranch.node },
+                        c.node, thenBranch.node, elseBranch.node), false, 0 });
+                    tasks.pop_back();
+                }
+                break;
+            }
+            }
+        }
+
+        return results.back().node;
+    }
+
+    // Nodes replaced by a constant (or a selected branch) in the last run
+    size_t foldedCount() const { return folded; }
+
+    // Nodes deduplicated against an identical subtree in the last run
+    size_t sharedCount() const { return shared; }
+};
+
+// A parsed program: the AST root together with the arena that owns its nodes
+class ParsedProgram {
+public:
+    Arena arena;
+    const ASTNode* root = nullptr;
+};
+
+// ============================================================================
+// Cost Analysis
+// ============================================================================
+
+// What evaluating a program can cost, bounded before it runs (see
+// CostAnalyzer). nodes and maxBits are upper bounds under exact (bigint)
+// arithmetic; wideWork applies BigInt::cost to the bounded operand widths.
+// The step counts are upper bounds under every backend, in the units each
+// evaluator's ExecutionBudget charges.
+struct CostEstimate {
+    static constexpr uint64_t UNBOUNDED = UINT64_MAX;
+
+    uint64_t nodes = 0;        // node evaluations by the tree evaluator
+    uint64_t treeSteps = 0;    // steps of the tree evaluator (one per stage)
+    uint64_t instructions = 0; // VM instructions executed, HALT included
+    uint64_t packedSteps = 0;  // operations of the packed evaluator
+    uint64_t wideWork = 0;     // extra steps bigint charges for wide operands
+    uint64_t maxBits = 0;      // widest value computed, in bits of magnitude
+    uint64_t resultBits = 0;   // width of the result
+
+    // Bound on the steps a step limit counts when running under backend:
+    // what GlyphInterpreter::estimate found its evaluator for that backend
+    // charges. CostAnalyzer fills in the default configuration, in which
+    // int32 runs on the VM and the other backends on the tree evaluator.
+    uint64_t charged[NUMERIC_BACKEND_COUNT] = {};
+
+    uint64_t steps(NumericBackend backend) const {
+        return charged[static_cast<size_t>(backend)];
+    }
+
+    // Every value fits in int64, so the int64 backends compute exactly what
+    // bigint does, errors included
+    bool fitsInt64() const { return maxBits <= 63; }
+
+    // Some value may exceed BigInt::MAX_BITS, which bigint rejects
+    bool mayExceedBigInt() const { return maxBits > BigInt::MAX_BITS; }
+};
+
+// Abstract interpretation of an AST. Each value is approximated by an
+// interval while both ends fit in int64, and by a bound on its bit width
+// beyond that; the operators are evaluated on those approximations, so a
+// huge '^' or doubling through nested '*' shows up as width without being
+// computed. A conditional whose condition can never be zero (or can only be
+// zero) counts just the branch it takes; otherwise the costs of the two
+// branches are maxed and their values joined. Step counts only trust the
+// condition while every value it computes fits in int32, since the narrow
+// backends wrap beyond that and may take the other branch. A VarNode, which
+// the parser never creates, is unbounded. Subtrees shared in a DAG are
+// analyzed once.
+class CostAnalyzer {
+private:
+    static constexpr uint64_t UNBOUNDED = CostEstimate::UNBOUNDED;
+
+    // The interval [lo, hi], or while wide only |value| < 2^bits
+    struct Bound {
+        bool wide;
+        int64_t lo;
+        int64_t hi;
+        uint64_t bits;
+    };
+
+    struct Summary {
+        Bound value;
+        uint64_t nodes;
+        uint64_t tree;   // tree evaluator steps
+        uint64_t code;   // VM instructions, HALT aside
+        uint64_t packed; // packed evaluator operations
+        uint64_t work;
+        uint64_t maxBits;
+    };
+
+    // A leaf: one step, one instruction and one operation everywhere
+    static Summary leaf(const Bound& value, uint64_t maxBits) {
+        return { value, 1, 1, 1, 1, 0, maxBits };
+    }
+
+    std::unordered_map<const ASTNode*, Summary> summaries;
+    std::vector<std::pair<const ASTNode*, bool>> stack;
+
+    static uint64_t add(uint64_t a, uint64_t b) {
+        return a > UNBOUNDED - b ? UNBOUNDED : a + b;
+    }
+
+    static uint64_t mul(uint64_t a, uint64_t b) {
+        uint64_t r;
+        return mulOverflow(a, b, r) ? UNBOUNDED : r;
+    }
+
+    static uint64_t magnitude(int64_t v) {
+        return v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    }
+
+    static uint64_t bitsOf(uint64_t m) {
+        uint64_t bits = 0;
+        for (; m != 0; m >>= 1) {
+            bits++;
+        }
+        return bits;
+    }
+
+    static Bound narrow(int64_t lo, int64_t hi) {
+        return { false, lo, hi, std::max(bitsOf(magnitude(lo)), bitsOf(magnitude(hi))) };
+    }
+
+    static Bound wide(uint64_t bits) {
+        return { true, 0, 0, bits };
+    }
+
+    static uint64_t maxMagnitude(const Bound& b) {
+        return std::max(magnitude(b.lo), magnitude(b.hi));
+    }
+
+    static bool canBeZero(const Bound& b) {
+        return b.wide || (b.lo <= 0 && b.hi >= 0);
+    }
+
+    static bool canBeNonzero(const Bound& b) {
+        return b.wide || b.lo != 0 || b.hi != 0;
+    }
+
+    static Bound join(const Bound& a, const Bound& b) {
+        if (a.wide || b.wide) {
+            return wide(std::max(a.bits, b.bits));
+        }
+        return narrow(std::min(a.lo, b.lo), std::max(a.hi, b.hi));
+    }
+
+    static Bound power(const Bound& base, const Bound& exponent) {
+        // A negative exponent gives 1 / base^n truncated: -1, 0 or 1
+        bool negative = exponent.wide || exponent.lo < 0;
+        bool nonNegative = exponent.wide || exponent.hi >= 0;
+        Bound small = narrow(-1, 1);
+        if (!nonNegative) {
+            return small;
+        }
+
+        uint64_t top = exponent.wide ? UNBOUNDED : static_cast<uint64_t>(exponent.hi);
+        Bound result;
+        if (top == 0 || (!base.wide && base.lo >= -1 && base.hi <= 1)) {
+            result = small;
+        }
+        else {
+            uint64_t m = base.wide ? UNBOUNDED : maxMagnitude(base);
+            uint64_t p = 1;
+            for (uint64_t i = 0; i < top && p <= static_cast<uint64_t>(INT64_MAX); i++) {
+                p = mul(p, m);
+            }
+            if (p <= static_cast<uint64_t>(INT64_MAX)) {
+                int64_t M = static_cast<int64_t>(p);
+                result = narrow(base.lo >= 0 ? 0 : -M, M);
+            }
+            else {
+                result = wide(mul(base.bits, top));
+            }
+        }
+        return negative ? join(result, small) : result;
+    }
+
+    static Bound remainder(const Bound& a, const Bound& b) {
+        // |a % b| < |b| and |a % b| <= |a|, with the sign of a
+        if (!b.wide) {
+            uint64_t m = maxMagnitude(b);
+            int64_t limit = static_cast<int64_t>(m == 0 ? 0 : m - 1);
+            if (a.wide) {
+                return narrow(-limit, limit);
+            }
+            return narrow(a.lo < 0 ? std::max(a.lo, -limit) : 0, a.hi > 0 ? std::min(a.hi, limit) : 0);
+        }
+        if (!a.wide) {
+            return narrow(std::min<int64_t>(a.lo, 0), std::max<int64_t>(a.hi, 0));
+        }
+        return wide(std::min(a.bits, b.bits));
+    }
+
+    static Bound apply(char op, const Bound& a, const Bound& b) {
+        bool exact = !a.wide && !b.wide;
+        int64_t lo, hi;
+        switch (op) {
+        case '+':
+            if (exact && !addOverflow(a.lo, b.lo, lo) && !addOverflow(a.hi, b.hi, hi)) {
+                return narrow(lo, hi);
+            }
+            return wide(add(std::max(a.bits, b.bits), 1));
+        case '-':
+            if (exact && !subOverflow(a.lo, b.hi, lo) && !subOverflow(a.hi, b.lo, hi)) {
+                return narrow(lo, hi);
+            }
+            return wide(add(std::max(a.bits, b.bits), 1));
+        case '*': {
+            int64_t p[4];
+            if (exact && !mulOverflow(a.lo, b.lo, p[0]) && !mulOverflow(a.lo, b.hi, p[1])
+                && !mulOverflow(a.hi, b.lo, p[2]) && !mulOverflow(a.hi, b.hi, p[3])) {
+                return narrow(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+            }
+            return wide(add(a.bits, b.bits));
+        }
+        case '^':
+            return power(a, b);
+        case '%':
+            return remainder(a, b);
+        default:
+            return narrow(0, 0); // never produces a value
+        }
+    }
+
+    // BigInt::cost with operand widths in place of operands. No value bigint
+    // accepts is much wider than MAX_BITS, which caps the widths used.
+    static uint64_t wideCost(char op, const Bound& a, const Bound& b) {
+        const uint64_t cap = 2 * BigInt::MAX_BITS;
+        auto limbs = [&](const Bound& v) { return v.bits <= 63 ? 2 : std::min(v.bits, cap) / 32 + 1; };
+        uint64_t la = limbs(a);
+        uint64_t lb = limbs(b);
+        switch (op) {
+        case '+':
+        case '-':
+            return (la + lb) / 64;
+        case '*':
+        case '%':
+            return la * lb / 64;
+        case '^': {
+            if (a.bits < 2 || (!b.wide && b.hi < 2)) {
+                return 0;
+            }
+            uint64_t top = b.wide ? UNBOUNDED : static_cast<uint64_t>(b.hi);
+            uint64_t resultLimbs = std::min(mul(std::min(a.bits, cap), top), cap) / 32 + 1;
+            return resultLimbs * resultLimbs / 64;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    Summary summarize(const ASTNode* node) const {
+        auto of = [&](const ASTNode* child) -> const Summary& { return summaries.find(child)->second; };
+
+        switch (node->type) {
+        case NodeType::VALUE:
+            return leaf(narrow(1, 1), 1);
+        case NodeType::CONST: {
+            Bound v = narrow(static_cast<const ConstNode*>(node)->value, static_cast<const ConstNode*>(node)->value);
+            return leaf(v, v.bits);
+        }
+        case NodeType::VAR:
+            return leaf(wide(UNBOUNDED), UNBOUNDED);
+        case NodeType::BINARY_OP: {
+            // Three stages in the tree evaluator, one instruction after the
+            // operands elsewhere
+            const auto* bin = static_cast<const BinaryOpNode*>(node);
+            const Summary& l = of(bin->left);
+            const Summary& r = of(bin->right);
+            Summary s;
+            s.value = apply(bin->op, l.value, r.value);
+            s.nodes = add(add(l.nodes, r.nodes), 1);
+            s.tree = add(add(l.tree, r.tree), 3);
+            s.code = add(add(l.code, r.code), 1);
+            s.packed = add(add(l.packed, r.packed), 1);
+            s.work = add(add(l.work, r.work), wideCost(bin->op, l.value, r.value));
+            s.maxBits = std::max({ l.maxBits, r.maxBits, s.value.bits });
+            return s;
+        }
+        case NodeType::LET: {
+            // Four stages; BIND and UNBIND; LET_BEGIN, NAME_END, VALUE_END
+            // and LET
+            const auto* let = static_cast<const LetNode*>(node);
+            const Summary& n = of(let->name);
+            const Summary& v = of(let->value);
+            const Summary& b = of(let->body);
+            Summary s;
+            s.value = b.value;
+            s.nodes = add(add(add(n.nodes, v.nodes), b.nodes), 1);
+            s.tree = add(add(add(n.tree, v.tree), b.tree), 4);
+            s.code = add(add(add(n.code, v.code), b.code), 2);
+            s.packed = add(add(add(n.packed, v.packed), b.packed), 4);
+            s.work = add(add(n.work, v.work), b.work);
+            s.maxBits = std::max({ n.maxBits, v.maxBits, b.maxBits });
+            return s;
+        }
+        case NodeType::COND:
+        default: {
+            // Three stages; a test, and a jump over the else branch after
+            // the then branch
+            const auto* cond = static_cast<const CondNode*>(node);
+            const Summary& c = of(cond->condition);
+            const Summary& t = of(cond->thenBranch);
+            const Summary& e = of(cond->elseBranch);
+            bool never = !canBeZero(c.value);
+            bool always = !canBeNonzero(c.value);
+            bool exactEverywhere = c.maxBits <= 31;
+
+            Summary s;
+            if (never) {
+                s = t;
+            }
+            else if (always) {
+                s = e;
+            }
+            else {
+                s = { join(t.value, e.value), std::max(t.nodes, e.nodes), 0, 0, 0, std::max(t.work, e.work),
+                    std::max(t.maxBits, e.maxBits) };
+            }
+            if (exactEverywhere && never) {
+                s.tree = t.tree;
+                s.code = add(t.code, 1);
+                s.packed = add(t.packed, 1);
+            }
+            else if (exactEverywhere && always) {
+                s.tree = e.tree;
+                s.code = e.code;
+                s.packed = e.packed;
+            }
+            else {
+                s.tree = std::max(t.tree, e.tree);
+                s.code = std::max(add(t.code, 1), e.code);
+                s.packed = std::max(add(t.packed, 1), e.packed);
+            }
+            s.nodes = add(add(c.nodes, s.nodes), 1);
+            s.tree = add(add(c.tree, s.tree), 3);
+            s.code = add(add(c.code, s.code), 1);
+            s.packed = add(add(c.packed, s.packed), 1);
+            s.work = add(c.work, s.work);
+            s.maxBits = std::max(c.maxBits, s.maxBits);
+            return s;
+        }
+        }
+    }
+
+public:
+    CostEstimate analyze(const ASTNode& root) {
+        summaries.clear();
+        stack.clear();
+
+        // Post-order over the DAG: a node is summarized after its children,
+        // and only once however many parents it has
+        stack.push_back({ &root, false });
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+            if (summaries.count(node) != 0) {
+                continue;
+            }
+            if (expanded) {
+                summaries.emplace(node, summarize(node));
+                continue;
+            }
+            stack.push_back({ node, true });
+            const ASTNode* kids[3];
+            int count = astChildren(node, kids);
+            for (int i = 0; i < count; i++) {
+                stack.push_back({ kids[i], false });
+            }
+        }
+
+        const Summary& s = summaries.find(&root)->second;
+        CostEstimate estimate;
+        estimate.nodes = s.nodes;
+        estimate.treeSteps = s.tree;
+        estimate.instructions = add(s.code, 1);
+        estimate.packedSteps = s.packed;
+        estimate.wideWork = s.work;
+        estimate.maxBits = s.maxBits;
+        estimate.resultBits = s.value.bits;
+        estimate.charged[static_cast<size_t>(NumericBackend::INT32)] = estimate.instructions;
+        estimate.charged[static_cast<size_t>(NumericBackend::INT64)] = s.tree;
+        estimate.charged[static_cast<size_t>(NumericBackend::CHECKED_INT64)] = s.tree;
+        estimate.charged[static_cast<size_t>(NumericBackend::BIGINT)] = add(s.tree, s.work);
+        return estimate;
+    }
+
+    // Distinct nodes in the last tree analyzed, shared subtrees counted once
+    size_t distinctNodes() const {
+        return summaries.size();
+    }
+};
+
+// ============================================================================
+// Source Scanning
+// ============================================================================
+
+// One pass over the raw source before parsing: finds the first byte outside
+// the nine-character alphabet and the deepest '(' nesting. Vector kernels
+// classify 16 or 32 bytes per step; the widest one the CPU supports is
+// picked once at startup.
+struct SourceScan {
+    size_t invalidOffset; // first invalid byte, or std::string_view::npos
+    size_t maxDepth;      // deepest bracket nesting (meaningful when valid)
+};
+
+struct GlyphCharTable {
+    bool valid[256];
+
+    constexpr GlyphCharTable() : valid() {
+        const char chars[] = "*()+-^%_:";
+        for (int i = 0; i < 9; i++) {
+            valid[static_cast<unsigned char>(chars[i])] = true;
+        }
+    }
+};
+
+inline constexpr GlyphCharTable GLYPH_CHARS{};
+
+inline bool isGlyphChar(char c) {
+    return GLYPH_CHARS.valid[static_cast<unsigned char>(c)];
+}
+
+// Scalar kernel, also used for the tails of the vector kernels
+inline SourceScan scanScalar(std::string_view src, size_t from, long depth, long maxDepth) {
+    for (size_t i = from; i < src.size(); i++) {
+        char c = src[i];
+        if (!isGlyphChar(c)) {
+            return { i, static_cast<size_t>(std::max(maxDepth, 0L)) };
+        }
+        if (c == '(') {
+            if (++depth > maxDepth) {
+                maxDepth = depth;
+            }
+        }
+        else if (c == ')') {
+            depth--;
+        }
+    }
+    return { std::string_view::npos, static_cast<size_t>(std::max(maxDepth, 0L)) };
+}
+
+inline SourceScan scanSourceScalar(std::string_view src) {
+    return scanScalar(src, 0, 0, 0);
+}
+
+#if defined(GLYPH_SIMD_X86)
+
+// Lanes equal to one of the nine glyph characters
+inline __m128i glyphMask128(__m128i v) {
+    __m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8('*'));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('(')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(')')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('^')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('%')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(':')));
+}
+
+// Per-byte nesting change: +1 for '(', -1 for ')', turned into an inclusive
+// prefix sum across the 16 lanes
+inline __m128i depthPrefix128(__m128i v) {
+    __m128i open = _mm_cmpeq_epi8(v, _mm_set1_epi8('('));
+    __m128i close = _mm_cmpeq_epi8(v, _mm_set1_epi8(')'));
+    __m128i d = _mm_sub_epi8(close, open);
+    d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+    d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+    d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+    return _mm_add_epi8(d, _mm_slli_si128(d, 8));
+}
+
+// Largest signed byte of v (SSE2 only has an unsigned byte max)
+inline int maxInt8x16(__m128i v) {
+    __m128i u = _mm_xor_si128(v, _mm_set1_epi8(static_cast<char>(0x80)));
+    u = _mm_max_epu8(u, _mm_srli_si128(u, 8));
+    u = _mm_max_epu8(u, _mm_srli_si128(u, 4));
+    u = _mm_max_epu8(u, _mm_srli_si128(u, 2));
+    u = _mm_max_epu8(u, _mm_srli_si128(u, 1));
+    return (_mm_cvtsi128_si32(u) & 0xFF) - 0x80;
+}
+
+inline int lastInt8x16(__m128i v) {
+    return static_cast<signed char>(_mm_cvtsi128_si32(_mm_srli_si128(v, 15)) & 0xFF);
+}
+
+inline int lowestSetBit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline SourceScan scanSourceSse2(std::string_view src) {
+    const char* p = src.data();
+    size_t n = src.size();
+    long depth = 0;
+    long maxDepth = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        unsigned bad = ~static_cast<unsigned>(_mm_movemask_epi8(glyphMask128(v))) & 0xFFFF;
+        if (bad != 0) {
+            return { i + lowestSetBit(bad), static_cast<size_t>(std::max(maxDepth, 0L)) };
+        }
+        __m128i prefix = depthPrefix128(v);
+        maxDepth = std::max(maxDepth, depth + maxInt8x16(prefix));
+        depth += lastInt8x16(prefix);
+    }
+    return scanScalar(src, i, depth, maxDepth);
+}
+
+GLYPH_TARGET_AVX2
+inline SourceScan scanSourceAvx2(std::string_view src) {
+    const char* p = src.data();
+    size_t n = src.size();
+    long depth = 0;
+    long maxDepth = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('*'));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('(')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('^')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('%')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+        unsigned bad = ~static_cast<unsigned>(_mm256_movemask_epi8(m));
+        if (bad != 0) {
+            return { i + lowestSetBit(bad), static_cast<size_t>(std::max(maxDepth, 0L)) };
+        }
+
+        // Prefix sums run within each 16-byte half; the upper half is then
+        // offset by the lower half's total.
+        __m256i open = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('('));
+        __m256i close = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')'));
+        __m256i d = _mm256_sub_epi8(close, open);
+        d = _mm256_add_epi8(d, _mm256_slli_si256(d, 1));
+        d = _mm256_add_epi8(d, _mm256_slli_si256(d, 2));
+        d = _mm256_add_epi8(d, _mm256_slli_si256(d, 4));
+        d = _mm256_add_epi8(d, _mm256_slli_si256(d, 8));
+        __m128i lo = _mm256_castsi256_si128(d);
+        __m128i hi = _mm256_extracti128_si256(d, 1);
+
+        long loTotal = lastInt8x16(lo);
+        maxDepth = std::max(maxDepth, depth + maxInt8x16(lo));
+        maxDepth = std::max(maxDepth, depth + loTotal + maxInt8x16(hi));
+        depth += loTotal + lastInt8x16(hi);
+    }
+    return scanScalar(src, i, depth, maxDepth);
+}
+
+inline bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    return osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(GLYPH_SIMD_NEON)
+
+inline SourceScan scanSourceNeon(std::string_view src) {
+    const char* p = src.data();
+    size_t n = src.size();
+    long depth = 0;
+    long maxDepth = 0;
+    size_t i = 0;
+    const int8x16_t zero = vdupq_n_s8(0);
+
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+        uint8x16_t m = vceqq_u8(v, vdupq_n_u8('*'));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('(')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8(')')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('+')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('-')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('^')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('%')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('_')));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8(':')));
+        if (vminvq_u8(m) == 0) {
+            // The scalar kernel pinpoints the offending byte
+            return scanScalar(src, i, depth, maxDepth);
+        }
+
+        int8x16_t open = vreinterpretq_s8_u8(vceqq_u8(v, vdupq_n_u8('(')));
+        int8x16_t close = vreinterpretq_s8_u8(vceqq_u8(v, vdupq_n_u8(')')));
+        int8x16_t d = vsubq_s8(close, open);
+        d = vaddq_s8(d, vextq_s8(zero, d, 15));
+        d = vaddq_s8(d, vextq_s8(zero, d, 14));
+        d = vaddq_s8(d, vextq_s8(zero, d, 12));
+        d = vaddq_s8(d, vextq_s8(zero, d, 8));
+        maxDepth = std::max(maxDepth, depth + vmaxvq_s8(d));
+        depth += vgetq_lane_s8(d, 15);
+    }
+    return scanScalar(src, i, depth, maxDepth);
+}
+
+#endif
+
+using SourceScanner = SourceScan (*)(std::string_view);
+
+struct ScannerChoice {
+    SourceScanner scan;
+    const char* name;
+};
+
+inline ScannerChoice selectScanner() {
+#if defined(GLYPH_SIMD_X86)
+    if (cpuHasAvx2()) {
+        return { scanSourceAvx2, "avx2" };
+    }
+    return { scanSourceSse2, "sse2" };
+#elif defined(GLYPH_SIMD_NEON)
+    return { scanSourceNeon, "neon" };
+#else
+    return { scanSourceScalar, "scalar" };
+#endif
+}
+
+inline const ScannerChoice& activeScanner() {
+    static const ScannerChoice choice = selectScanner();
+    return choice;
+}
+
+// Validates src and measures its bracket nesting with the best kernel
+inline SourceScan scanSource(std::string_view src) {
+    return activeScanner().scan(src);
+}
+
+// Name of the kernel scanSource dispatches to ("avx2", "sse2", "neon", "scalar")
+inline const char* sourceScannerName() {
+    return activeScanner().name;
+}
+
+// ============================================================================
+// Lexer / Tokenizer
+// ============================================================================
+
+class Lexer {
+private:
+    std::string_view input; // not owned; must outlive the lexer
+    size_t pos;
+
+public:
+    Lexer(std::string_view src) : input(src), pos(0) {}
+
+    char peek() const {
+        if (pos >= input.length()) return '\0';
+        return input[pos];
+    }
+
+    char consume() {
+        if (pos >= input.length()) return '\0';
+        return input[pos++];
+    }
+
+    void expect(char c) {
+        char ch = consume();
+        if (ch != c) {
+            throw std::runtime_error(std::string("Expected '") + c + "' but got '" + ch + "'");
+        }
+    }
+
+    bool isOperator(char c) const {
+        return c == '+' || c == '-' || c == '*' || c == '^' || c == '%';
+    }
+
+    bool isValidChar(char c) const {
+        return isGlyphChar(c);
+    }
+};
+
+// ============================================================================
+// Parser
+// ============================================================================
+
+// Builds arena-allocated AST nodes. A builder sees every expression as it
+// opens, after each operand, and when it closes; kind is the operator
+// character, '?' for a conditional or ':' for let.
+class TreeBuilder {
+private:
+    Arena& arena;
+
+public:
+    using Node = const ASTNode*;
+    using Target = Arena;
+
+    TreeBuilder(Arena& nodes) : arena(nodes) {}
+
+    Node unit() { return ValueNode::instance(); }
+    void open(char) {}
+    void operand(char, int) {}
+
+    Node build(char kind, const Node* children) {
+        switch (kind) {
+        case ':':
+            return arena.make<LetNode>(children[0], children[1], children[2]);
+        case '?':
+            return arena.make<CondNode>(children[0], children[1], children[2]);
+        default:
+            return arena.make<BinaryOpNode>(kind, children[0], children[1]);
+        }
+    }
+};
+
+template <typename Builder>
+class BasicParser {
+private:
+    using Node = typename Builder::Node;
+
+    // A compound expression whose operands are still being parsed
+    struct Frame {
+        char kind;  // operator character, '?' for a conditional, ':' for let
+        int arity;
+        int count;
+        Node children[3];
+    };
+
+    Lexer& lexer;
+    Builder builder;
+    size_t maxDepth;
+    std::vector<Frame> frames;
+
+    void open(char kind, int arity) {
+        if (maxDepth != 0 && frames.size() >= maxDepth) {
+            throw std::runtime_error("Maximum nesting depth of " + std::to_string(maxDepth) + " exceeded");
+        }
+        frames.push_back({ kind, arity, 0, {} });
+        builder.open(kind);
+    }
+
+public:
+    static constexpr size_t DEFAULT_MAX_DEPTH = 1000000;
+
+    // maxDepth bounds how many expressions may be open at once (0 = no limit)
+    BasicParser(Lexer& lex, typename Builder::Target& target, size_t depthLimit = DEFAULT_MAX_DEPTH)
+        : lexer(lex), builder(target), maxDepth(depthLimit) {}
+
+    void setMaxDepth(size_t depthLimit) {
+        maxDepth = depthLimit;
+    }
+
+    // Pre-size the frame stack for a program nested depth levels deep
+    void reserve(size_t depth) {
+        frames.reserve(maxDepth != 0 ? std::min(depth + 1, maxDepth) : depth + 1);
+    }
+
+    // Non-recursive: open expressions are kept on a heap-allocated frame
+    // stack, so nesting depth is limited only by maxDepth.
+    Node parseExpression() {
+        frames.clear();
+
+        for (;;) {
+            Node node;
+            char ch = lexer.peek();
+
+            if (ch == '\0') {
+                throw std::runtime_error("Unexpected end of input");
+            }
+
+            if (ch == '_') {
+                lexer.consume();
+                node = builder.unit();
+            }
+            else if (ch == '(') {
+                lexer.consume(); // eat '('
+
+                char next = lexer.peek();
+
+                // Check for operators
+                if (lexer.isOperator(next)) {
+                    char op = lexer.consume();
+
+                    // Special case: % can be conditional: %(cond)(then)(else)
+                    if (op == '%' && lexer.peek() == '(') {
+                        open('?', 3);
+                    }
+                    else {
+                        open(op, 2);
+                    }
+                    continue;
+                }
+
+                // Check for let binding
+                if (next == ':') {
+                    lexer.consume(); // eat ':'
+                    open(':', 3);
+                    continue;
+                }
+
+                throw std::runtime_error("Invalid expression starting with '('");
+            }
+            else {
+                throw std::runtime_error(std::string("Unexpected character: ") + ch);
+            }
+
+            // Hand the finished node to its parent, closing every expression
+            // that this completes.
+            for (;;) {
+                if (frames.empty()) {
+                    return node;
+                }
+                Frame& top = frames.back();
+                top.children[top.count++] = node;
+                if (top.count < top.arity) {
+                    builder.operand(top.kind, top.count - 1);
+                    break;
+                }
+                lexer.expect(')');
+                node = builder.build(top.kind, top.children);
+                frames.pop_back();
+            }
+        }
+    }
+};
+
+using Parser = BasicParser<TreeBuilder>;
+
+// ============================================================================
+// Streaming Evaluation
+// ============================================================================
+
+// Parses and evaluates a program in one pass as its bytes arrive, with no
+// AST: each open expression is a frame holding at most one value, so memory
+// is O(nesting) however long the program is. Input may be fed in chunks of
+// any size, split anywhere.
+//
+// Results and errors match validating, parsing and then evaluating the whole
+// text. That has two consequences for a single pass. First, an invalid
+// character or syntax error anywhere wins over an evaluation error, so after
+// an evaluation error the rest is still parsed, evaluating nothing. Second,
+// the evaluator runs a let's value before its name, so an error inside a
+// name is held on the let until its value has run without failing. Untaken
+// conditional branches are parsed, never evaluated. Step and time limits
+// count evaluated nodes and are raised by the feed() that hits them. Errors
+// are kept as codes with their byte offset, so tryEvaluate() reports them
+// without throwing or building a message.
+template <typename Backend>
+class BasicStreamEvaluator {
+public:
+    using Value = typename Backend::Value;
+
+private:
+    enum class State : uint8_t {
+        EXPRESSION, // an expression must start here
+        OPENED,     // after '('
+        PERCENT,    // after "(%": a conditional if '(' follows
+        CLOSE,      // every operand is in; ')' must follow
+        DONE,       // the program is complete; the rest is only validated
+        SCANNING,   // after a syntax error; the rest is only validated
+        STOPPED     // after an invalid character or exceeded limit
+    };
+
+    struct Frame {
+        char kind;      // operator character, '?' for a conditional, ':' for let
+        int arity;
+        int count;      // operands completed so far
+        int chosen;     // conditional: the branch to evaluate (1 or 2)
+        bool skip;      // parsed for syntax only
+        bool deferred;  // let: its name failed with deferredError
+        Value value;    // left operand, then the result
+    };
+
+    // An error as a code; its message is built only if it is thrown
+    struct Failure {
+        GlyphError code = GlyphError::NONE;
+        size_t detail = 0;
+        size_t offset = 0;
+    };
+
+    size_t maxDepth;
+    ExecutionLimits limits;
+    ExecutionBudget budget{ ExecutionLimits() };
+    std::vector<Frame> frames;
+    State state = State::EXPRESSION;
+    size_t at = 0; // offset of the byte being read
+    bool failed = false; // an evaluation error is pending in error
+    Failure error;
+    // Everything inside a let whose name failed is skipped, so at most one
+    // let holds an error at a time
+    Failure deferredError;
+    Failure syntaxError;
+    Failure fatal; // why the evaluator STOPPED
+    Value result{};
+
+    void syntax(GlyphError code, size_t detail = 0) {
+        syntaxError = { code, detail, at };
+        state = State::SCANNING;
+    }
+
+    void stop(GlyphError code, size_t detail = 0) {
+        fatal = { code, detail, at };
+        state = State::STOPPED;
+    }
+
+    // Takes steps from the budget; false, and stopped, once a limit is hit
+    bool charge(uint64_t steps = 1) {
+        GlyphError limit = budget.tryCharge(steps);
+        if (limit == GlyphError::NONE) {
+            return true;
+        }
+        stop(limit);
+        return false;
+    }
+
+    [[noreturn]] static void raise(const Failure& f) {
+        if (f.code == GlyphError::STEP_LIMIT) {
+            throw StepLimitExceeded();
+        }
+        if (f.code == GlyphError::DEADLINE) {
+            throw DeadlineExceeded();
+        }
+        throw std::runtime_error(glyphErrorMessage(f.code, f.detail));
+    }
+
+    // Whether the expression starting now is only parsed
+    bool skipping() const {
+        if (frames.empty()) {
+            return failed;
+        }
+        const Frame& f = frames.back();
+        return f.skip || (f.kind == '?' && f.count > 0 && f.count != f.chosen);
+    }
+
+    // Records that the expression completing at depth `level` (enclosed by
+    // frames[0, level)) failed. The error goes to the innermost enclosing
+    // let still reading its name, if any, else it is the program's error.
+    void fail(const Failure& failure, size_t level) {
+        size_t owner = level;
+        while (owner-- > 0) {
+            Frame& f = frames[owner];
+            if (f.kind == ':' && f.count == 0) {
+                f.deferred = true;
+                deferredError = failure;
+                for (size_t i = owner + 1; i < frames.size(); i++) {
+                    frames[i].skip = true;
+                }
+                return;
+            }
+        }
+        failed = true;
+        error = failure;
+        for (Frame& f : frames) {
+            f.skip = true;
+        }
+    }
+
+    void open(char kind, int arity) {
+        if (maxDepth != 0 && frames.size() >= maxDepth) {
+            syntax(GlyphError::NESTING_TOO_DEEP, maxDepth);
+            return;
+        }
+        bool skip = skipping();
+        if (!skip && !charge()) {
+            return;
+        }
+        frames.push_back({ kind, arity, 0, 0, skip, false, Value() });
+        state = State::EXPRESSION;
+    }
+
+    // Hands a completed expression to its parent; evaluated says whether
+    // value holds its result
+    void complete(bool evaluated, Value value) {
+        if (frames.empty()) {
+            if (evaluated) {
+                result = std::move(value);
+            }
+            state = State::DONE;
+            return;
+        }
+
+        size_t top = frames.size() - 1;
+        Frame& f = frames[top];
+        int index = f.count++;
+        if (evaluated && !f.skip) {
+            switch (f.kind) {
+            case '?':
+                if (index == 0) {
+                    f.chosen = Backend::isZero(value) ? 2 : 1;
+                }
+                else {
+                    f.value = std::move(value);
+                }
+                break;
+            case ':':
+                if (index == 1 && f.deferred) {
+                    // The value ran cleanly, so the name's error stands
+                    fail(deferredError, top);
+                }
+                else if (index == 2) {
+                    f.value = std::move(value);
+                }
+                break;
+            default: {
+                if (index == 0) {
+                    f.value = std::move(value);
+                    break;
+                }
+                if (budget.limited() && !charge(Backend::cost(f.kind, f.value, value))) {
+                    return;
+                }
+                GlyphError failure = Backend::tryApply(f.kind, f.value, value, f.value);
+                if (failure != GlyphError::NONE) {
+                    fail({ failure, static_cast<size_t>(f.kind), at }, top);
+                }
+                break;
+            }
+            }
+        }
+        state = f.count < f.arity ? State::EXPRESSION : State::CLOSE;
+    }
+
+    void close() {
+        Frame f = std::move(frames.back());
+        frames.pop_back();
+        complete(!f.skip, std::move(f.value));
+    }
+
+    // Advances the parser by one character; returns false if c must be
+    // looked at again in the new state
+    bool step(char c) {
+        switch (state) {
+        case State::EXPRESSION:
+            if (c == '_') {
+                bool evaluated = !skipping();
+                if (evaluated && !charge()) {
+                    return true;
+                }
+                complete(evaluated, Backend::unit());
+            }
+            else if (c == '(') {
+                state = State::OPENED;
+            }
+            else {
+                syntax(GlyphError::UNEXPECTED_CHARACTER, static_cast<unsigned char>(c));
+            }
+            return true;
+
+        case State::OPENED:
+            if (c == '%') {
+                state = State::PERCENT;
+            }
+            else if (c == '+' || c == '-' || c == '*' || c == '^') {
+                open(c, 2);
+            }
+            else if (c == ':') {
+                open(':', 3);
+            }
+            else {
+                syntax(GlyphError::INVALID_EXPRESSION);
+            }
+            return true;
+
+        case State::PERCENT:
+            open(c == '(' ? '?' : '%', c == '(' ? 3 : 2);
+            return state == State::STOPPED;
+
+        case State::CLOSE:
+            if (c == ')') {
+                close();
+            }
+            else {
+                syntax(GlyphError::EXPECTED_CLOSE, static_cast<unsigned char>(c));
+            }
+            return true;
+
+        case State::DONE:
+        case State::SCANNING:
+        case State::STOPPED:
+            return true;
+        }
+        return true;
+    }
+
+    void consume(std::string_view chunk) {
+        for (size_t i = 0; i < chunk.size() && state != State::STOPPED; i++, at++) {
+            char c = chunk[i];
+            if (!isGlyphChar(c)) {
+                stop(GlyphError::INVALID_CHARACTER, static_cast<unsigned char>(c));
+                return;
+            }
+            while (!step(c)) {
+            }
+        }
+    }
+
+    // Ends the input; the program's error, or null if it has a value
+    const Failure* settle() {
+        switch (state) {
+        case State::EXPRESSION:
+            syntax(GlyphError::UNEXPECTED_END);
+            break;
+        case State::OPENED:
+            syntax(GlyphError::INVALID_EXPRESSION);
+            break;
+        case State::PERCENT:
+            open('%', 2); // "(%" at the end is a modulo missing its operands
+            if (state == State::EXPRESSION) {
+                syntax(GlyphError::UNEXPECTED_END);
+            }
+            break;
+        case State::CLOSE:
+            syntax(GlyphError::EXPECTED_CLOSE, 0);
+            break;
+        case State::DONE:
+        case State::SCANNING:
+        case State::STOPPED:
+            break;
+        }
+        if (state == State::STOPPED) {
+            return &fatal;
+        }
+        if (syntaxError.code != GlyphError::NONE) {
+            return &syntaxError;
+        }
+        return failed ? &error : nullptr;
+    }
+
+public:
+    // depthLimit bounds how many expressions may be open at once, as in the
+    // Parser (0 = no limit)
+    explicit BasicStreamEvaluator(size_t depthLimit = Parser::DEFAULT_MAX_DEPTH)
+        : maxDepth(depthLimit) {}
+
+    void setMaxDepth(size_t depthLimit) {
+        maxDepth = depthLimit;
+    }
+
+    // Step and time limits for each program, applied from the next reset()
+    void setLimits(const ExecutionLimits& l) {
+        limits = l;
+    }
+
+    // Starts a new program; the clock for the time limit starts here
+    void reset() {
+        frames.clear();
+        state = State::EXPRESSION;
+        at = 0;
+        failed = false;
+        error = Failure();
+        deferredError = Failure();
+        syntaxError = Failure();
+        fatal = Failure();
+        result = Value();
+        budget = ExecutionBudget(limits);
+    }
+
+    // Consumes the next bytes of the program. Throws for an invalid
+    // character or an exceeded limit, and ignores the rest of the input
+    // after one; other errors are raised by finish().
+    void feed(std::string_view chunk) {
+        consume(chunk);
+        if (state == State::STOPPED) {
+            raise(fatal);
+        }
+    }
+
+    // Ends the input and returns the program's value
+    Value finish() {
+        const Failure* failure = settle();
+        if (failure != nullptr) {
+            raise(*failure);
+        }
+        return std::move(result);
+    }
+
+    // Evaluates a whole program without throwing for any error in it
+    BasicRunResult<Value> tryEvaluate(std::string_view program) {
+        reset();
+        consume(program);
+        const Failure* failure = settle();
+        if (failure != nullptr) {
+            return BasicRunResult<Value>(failure->code, failure->detail, failure->offset);
+        }
+        return BasicRunResult<Value>(std::move(result));
+    }
+
+    // Evaluates the program read from a std::istream to its end, a chunk at
+    // a time. A template so that this header needs no <istream>.
+    template <typename Stream, typename = std::enable_if_t<std::is_base_of<std::istream, Stream>::value>>
+    Value run(Stream& in) {
+        char buffer[64 * 1024];
+        reset();
+        while (in) {
+            in.read(buffer, sizeof(buffer));
+            feed(std::string_view(buffer, static_cast<size_t>(in.gcount())));
+        }
+        return finish();
+    }
+};
+
+using StreamEvaluator = BasicStreamEvaluator<Int32Backend>;
+
+// ============================================================================
+// Packed AST
+// ============================================================================
+
+// The AST flattened into one contiguous byte array in post-order: a node is
+// a single opcode byte following its operands, so `_` and every operator
+// take one byte each. Only control flow carries an offset, stored inline
+// after its opcode as a 4-byte jump relative to the end of the offset:
+//
+//   (op a b)           [a] [b] op
+//   (%(c)(t)(e))       [c] TEST->e [t] SKIP->end [e]
+//   (:(n)(v)(b))       LET_BEGIN->v [n] NAME_END->b [v] VALUE_END->n [b] LET
+//
+// The markers keep the tree evaluator's order: the untaken branch is never
+// evaluated, and a let's value runs before its name.
+enum class PackedOp : uint8_t {
+    UNIT,       // push 1
+    ADD,        // pop b, pop a, push a + b
+    SUB,        // pop b, pop a, push a - b
+    MUL,        // pop b, pop a, push a * b
+    POW,        // pop b, pop a, push a ^ b
+    MOD,        // pop b, pop a, push a % b
+    TEST,       // pop c, jump to the else branch if c == 0
+    SKIP,       // jump over the else branch
+    LET_BEGIN,  // jump over the name to the value
+    NAME_END,   // the name is done, jump to the body
+    VALUE_END,  // the value is done, jump back to the name
+    LET         // pop body, name and value, push body
+};
+
+struct PackedAST {
+    std::vector<uint8_t> code;
+    size_t maxStackDepth = 0;
+};
+
+// Parser builder that emits a PackedAST directly instead of allocating
+// nodes; nothing but the code array is kept per node.
+class PackedBuilder {
+private:
+    static constexpr size_t OFFSET_SIZE = 4;
+
+    PackedAST& out;
+    std::vector<size_t> pending; // offsets waiting for their jump target
+    size_t depth = 0;
+
+    void emit(PackedOp op) {
+        out.code.push_back(static_cast<uint8_t>(op));
+    }
+
+    // Emits op with a placeholder offset; returns where the offset lives
+    size_t emitJump(PackedOp op) {
+        emit(op);
+        size_t at = out.code.size();
+        out.code.resize(at + OFFSET_SIZE);
+        return at;
+    }
+
+    // Points the offset stored at `at` to `target`
+    void patch(size_t at, size_t target) {
+        int32_t offset = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + OFFSET_SIZE));
+        std::memcpy(&out.code[at], &offset, OFFSET_SIZE);
+    }
+
+    void push(size_t n) {
+        depth += n;
+        out.maxStackDepth = std::max(out.maxStackDepth, depth);
+    }
+
+public:
+    struct Node {};
+    using Target = PackedAST;
+
+    PackedBuilder(PackedAST& program) : out(program) {
+        out.code.clear();
+        out.maxStackDepth = 0;
+    }
+
+    Node unit() {
+        emit(PackedOp::UNIT);
+        push(1);
+        return {};
+    }
+
+    void open(char kind) {
+        if (kind == ':') {
+            pending.push_back(emitJump(PackedOp::LET_BEGIN));
+        }
+    }
+
+    void operand(char kind, int index) {
+        if (kind == '?') {
+            if (index == 0) {
+                depth--; // TEST pops the condition
+                pending.push_back(emitJump(PackedOp::TEST));
+            }
+            else {
+                size_t test = pending.back();
+                pending.back() = emitJump(PackedOp::SKIP);
+                patch(test, out.code.size());
+                depth--; // the else branch starts from the same depth
+            }
+        }
+        else if (kind == ':') {
+            if (index == 0) {
+                size_t begin = pending.back();
+                pending.push_back(emitJump(PackedOp::NAME_END));
+                patch(begin, out.code.size());
+            }
+            else {
+                size_t nameEnd = pending.back();
+                pending.pop_back();
+                size_t begin = pending.back();
+                pending.pop_back();
+                patch(emitJump(PackedOp::VALUE_END), begin + OFFSET_SIZE);
+                patch(nameEnd, out.code.size());
+            }
+        }
+    }
+
+    Node build(char kind, const Node*) {
+        switch (kind) {
+        case '?':
+            patch(pending.back(), out.code.size());
+            pending.pop_back();
+            break;
+        case ':':
+            emit(PackedOp::LET);
+            depth -= 2;
+            break;
+        case '+': emit(PackedOp::ADD); depth--; break;
+        case '-': emit(PackedOp::SUB); depth--; break;
+        case '*': emit(PackedOp::MUL); depth--; break;
+        case '^': emit(PackedOp::POW); depth--; break;
+        case '%': emit(PackedOp::MOD); depth--; break;
+        }
+        return {};
+    }
+};
+
+using PackedParser = BasicParser<PackedBuilder>;
+
+// Evaluates a PackedAST in a single pass over the code with a value stack.
+// Jumps only skip or reorder whole subtrees, so no byte runs twice.
+template <typename Backend>
+class BasicPackedEvaluator {
+private:
+    using Value = typename Backend::Value;
+
+    std::vector<Value> stack;
+    ExecutionLimits limits;
+
+    Value pop() {
+        Value v = std::move(stack.back());
+        stack.pop_back();
+        return v;
+    }
+
+public:
+    // Step and time limits applied to each evaluate() call
+    void setLimits(const ExecutionLimits& l) {
+        limits = l;
+    }
+
+    Value evaluate(const PackedAST& program) {
+        stack.clear();
+        stack.reserve(program.maxStackDepth);
+        ExecutionBudget budget(limits);
+        auto charge = [&budget](char op, const Value& a, const Value& b) {
+            if (budget.limited()) {
+                budget.charge(Backend::cost(op, a, b));
+            }
+        };
+
+        const uint8_t* code = program.code.data();
+        const uint8_t* pc = code;
+        const uint8_t* end = code + program.code.size();
+
+        auto jump = [&pc]() {
+            int32_t offset;
+            std::memcpy(&offset, pc, sizeof(offset));
+            pc += sizeof(offset) + offset;
+        };
+
+        while (pc != end) {
+            budget.charge();
+            switch (static_cast<PackedOp>(*pc++)) {
+            case PackedOp::UNIT:
+                stack.push_back(Backend::unit());
+                break;
+            case PackedOp::ADD: {
+                Value b = pop();
+                charge('+', stack.back(), b);
+                stack.back() = Backend::add(stack.back(), b);
+                break;
+            }
+            case PackedOp::SUB: {
+                Value b = pop();
+                charge('-', stack.back(), b);
+                stack.back() = Backend::sub(stack.back(), b);
+                break;
+            }
+            case PackedOp::MUL: {
+                Value b = pop();
+                charge('*', stack.back(), b);
+                stack.back() = Backend::mul(stack.back(), b);
+                break;
+            }
+            case PackedOp::POW: {
+                Value b = pop();
+                charge('^', stack.back(), b);
+                stack.back() = Backend::pow(stack.back(), b);
+                break;
+            }
+            case PackedOp::MOD: {
+                Value b = pop();
+                charge('%', stack.back(), b);
+                stack.back() = Backend::mod(stack.back(), b);
+                break;
+            }
+            case PackedOp::TEST:
+                if (Backend::isZero(pop())) {
+                    jump();
+                }
+                else {
+                    pc += sizeof(int32_t);
+                }
+                break;
+            case PackedOp::SKIP:
+            case PackedOp::LET_BEGIN:
+            case PackedOp::NAME_END:
+            case PackedOp::VALUE_END:
+                jump();
+                break;
+            case PackedOp::LET: {
+                // Nothing in parsed source can read a binding, so the name
+                // and value are evaluated for their errors only.
+                Value body = pop();
+                stack.pop_back();
+                stack.back() = std::move(body);
+                break;
+            }
+            }
+        }
+        return pop();
+    }
+};
+
+// ============================================================================
+// Bytecode
+// ============================================================================
+
+// Stack machine instructions. Operands are popped right-to-left, so for
+// binary operators the right operand is on top of the stack.
+enum class OpCode : uint8_t {
+    PUSH_UNIT,      // push 1
+    PUSH_CONST,     // push operand
+    ADD,            // pop b, pop a, push a + b
+    SUB,            // pop b, pop a, push a - b
+    MUL,            // pop b, pop a, push a * b
+    POW,            // pop b, pop a, push a ^ b
+    MOD,            // pop b, pop a, push a % b
+    JUMP,           // pc = operand
+    JUMP_IF_ZERO,   // pop c, if c == 0 then pc = operand
+    BIND,           // pop name, pop value, push binding name -> value
+    UNBIND,         // drop the innermost binding
+    LOAD,           // push the value bound to operand
+    HALT,           // return top of stack
+    LOAD_SLOT       // push the value of binding number operand, outermost first
+};
+
+struct Instruction {
+    OpCode op;
+    int operand;
+};
+
+struct NativeTier;
+
+// Non-owning form of a compiled program, which is all the VM needs; it may
+// point into a Bytecode or straight into a mapped bytecode file
+struct BytecodeView {
+    const Instruction* code = nullptr;
+    size_t size = 0;
+    int maxStackDepth = 0;
+    int maxBindingDepth = 0;
+};
+
+// A compiled program: flat instruction stream plus the stack sizes the VM
+// needs, so execution never has to grow its buffers.
+struct Bytecode {
+    std::vector<Instruction> code;
+    int maxStackDepth = 0;
+    int maxBindingDepth = 0;
+    // Execution count and native code for JIT promotion, shared by copies;
+    // null for programs that are run once (see GlyphInterpreter::compile)
+    std::shared_ptr<NativeTier> native;
+
+    BytecodeView view() const {
+        return { code.data(), code.size(), maxStackDepth, maxBindingDepth };
+    }
+};
+
+// ============================================================================
+// Native Code
+// ============================================================================
+
+// Template JIT for int32 bytecode on x86-64. Each instruction becomes a fixed
+// native sequence with the top of the stack in eax and the rest in a caller
+// buffer addressed by rbx, so there is no dispatch at all; pow and mod call
+// out to the interpreter's own helpers. Nothing thrown may cross generated
+// frames, so a failing operation makes the native function return a failure
+// flag instead, and the caller re-runs the program on the VM to raise the
+// error. Elsewhere NativeProgram::SUPPORTED is false and compile() declines.
+class NativeProgram {
+public:
+#if defined(GLYPH_JIT)
+    static constexpr bool SUPPORTED = true;
+#else
+    static constexpr bool SUPPORTED = false;
+#endif
+
+private:
+    // Native functions return the value in the low 32 bits, or this
+    static constexpr uint64_t FAILED = uint64_t(1) << 32;
+
+    using Entry = uint64_t (*)(int* stack);
+
+    void* memory = nullptr;
+    size_t mapped = 0;
+    Entry entry = nullptr;
+
+    static uint64_t callPow(int a, int b) noexcept {
+        int result;
+        return powStatus(a, b, result) == GlyphError::NONE ? static_cast<uint32_t>(result) : FAILED;
+    }
+
+    static uint64_t callMod(int a, int b) noexcept {
+        int result;
+        return modStatus(a, b, result) == GlyphError::NONE ? static_cast<uint32_t>(result) : FAILED;
+    }
+
+    void release() {
+#if defined(GLYPH_JIT)
+        if (memory != nullptr) {
+            munmap(memory, mapped);
+        }
+#endif
+        memory = nullptr;
+        mapped = 0;
+        entry = nullptr;
+    }
+
+#if defined(GLYPH_JIT)
+    struct Emitter {
+        std::vector<uint8_t> code;
+
+        void bytes(std::initializer_list<uint8_t> b) {
+            code.insert(code.end(), b);
+        }
+
+        void imm32(uint32_t v) {
+            for (int i = 0; i < 4; i++) {
+                code.push_back(static_cast<uint8_t>(v >> (8 * i)));
+            }
+        }
+
+        void imm64(uint64_t v) {
+            imm32(static_cast<uint32_t>(v));
+            imm32(static_cast<uint32_t>(v >> 32));
+        }
+
+        // Writes a rel32 at `at` reaching `target`
+        void patch(size_t at, size_t target) {
+            uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+            for (int i = 0; i < 4; i++) {
+                code[at + i] = static_cast<uint8_t>(rel >> (8 * i));
+            }
+        }
+
+        void push(uint32_t value) {
+            bytes({ 0x89, 0x03 });             // mov [rbx], eax
+            bytes({ 0x48, 0x83, 0xC3, 0x04 }); // add rbx, 4
+            bytes({ 0xB8 });                   // mov eax, value
+            imm32(value);
+        }
+
+        // Pops the second entry into eax, leaving the old top in ecx
+        void popIntoEax() {
+            bytes({ 0x89, 0xC1 });             // mov ecx, eax
+            bytes({ 0x48, 0x83, 0xEB, 0x04 }); // sub rbx, 4
+            bytes({ 0x8B, 0x03 });             // mov eax, [rbx]
+        }
+
+        // eax = helper(second, top); returns the offset of the failure jump
+        size_t call(uint64_t (*helper)(int, int) noexcept) {
+            bytes({ 0x48, 0x83, 0xEB, 0x04 });       // sub rbx, 4
+            bytes({ 0x89, 0xC6 });                   // mov esi, eax
+            bytes({ 0x8B, 0x3B });                   // mov edi, [rbx]
+            bytes({ 0x48, 0xB8 });                   // mov rax, helper
+            imm64(reinterpret_cast<uint64_t>(helper));
+            bytes({ 0xFF, 0xD0 });                   // call rax
+            bytes({ 0x48, 0x0F, 0xBA, 0xE0, 0x20 }); // bt rax, 32
+            bytes({ 0x0F, 0x82 });                   // jc failure
+            imm32(0);
+            return code.size() - 4;
+        }
+    };
+
+    // Generates code for program; false if it uses an unsupported instruction
+    static bool generate(const Bytecode& program, Emitter& out) {
+        struct Fixup {
+            size_t at;
+            size_t target; // instruction index, or code.size() for the failure exit
+        };
+        const size_t count = program.code.size();
+        std::vector<size_t> offsets(count + 1);
+        std::vector<Fixup> fixups;
+
+        out.bytes({ 0x53 });             // push rbx (also aligns rsp for calls)
+        out.bytes({ 0x48, 0x89, 0xFB }); // mov rbx, rdi
+        for (size_t i = 0; i < count; i++) {
+            const Instruction& ins = program.code[i];
+            offsets[i] = out.code.size();
+            switch (ins.op) {
+            case OpCode::PUSH_UNIT:
+                out.push(1);
+                break;
+            case OpCode::PUSH_CONST:
+                out.push(static_cast<uint32_t>(ins.operand));
+                break;
+            case OpCode::ADD:
+                out.bytes({ 0x48, 0x83, 0xEB, 0x04 }); // sub rbx, 4
+                out.bytes({ 0x03, 0x03 });             // add eax, [rbx]
+                break;
+            case OpCode::SUB:
+                out.popIntoEax();
+                out.bytes({ 0x29, 0xC8 });             // sub eax, ecx
+                break;
+            case OpCode::MUL:
+                out.bytes({ 0x48, 0x83, 0xEB, 0x04 }); // sub rbx, 4
+                out.bytes({ 0x0F, 0xAF, 0x03 });       // imul eax, [rbx]
+                break;
+            case OpCode::POW:
+                fixups.push_back({ out.call(&callPow), count });
+                break;
+            case OpCode::MOD:
+                fixups.push_back({ out.call(&callMod), count });
+                break;
+            case OpCode::JUMP:
+                out.bytes({ 0xE9 });                   // jmp target
+                out.imm32(0);
+                fixups.push_back({ out.code.size() - 4, static_cast<size_t>(ins.operand) });
+                break;
+            case OpCode::JUMP_IF_ZERO:
+                out.popIntoEax();
+                out.bytes({ 0x85, 0xC9 });             // test ecx, ecx
+                out.bytes({ 0x0F, 0x84 });             // jz target
+                out.imm32(0);
+                fixups.push_back({ out.code.size() - 4, static_cast<size_t>(ins.operand) });
+                break;
+            case OpCode::BIND:
+                // Nothing loads a binding (see below), so binding is popping
+                // the name and value
+                out.bytes({ 0x48, 0x83, 0xEB, 0x08 }); // sub rbx, 8
+                out.bytes({ 0x8B, 0x03 });             // mov eax, [rbx]
+                break;
+            case OpCode::UNBIND:
+                break;
+            case OpCode::LOAD:
+            case OpCode::LOAD_SLOT:
+                return false;
+            case OpCode::HALT:
+                out.bytes({ 0x5B, 0xC3 });             // pop rbx; ret
+                break;
+            }
+        }
+
+        offsets[count] = out.code.size();
+        out.bytes({ 0x48, 0xB8 });                     // mov rax, FAILED
+        out.imm64(FAILED);
+        out.bytes({ 0x5B, 0xC3 });                     // pop rbx; ret
+
+        for (const Fixup& f : fixups) {
+            if (f.target > count) {
+                return false;
+            }
+            out.patch(f.at, offsets[f.target]);
+        }
+        return true;
+    }
+#endif
+
+public:
+    NativeProgram() = default;
+    NativeProgram(const NativeProgram&) = delete;
+    NativeProgram& operator=(const NativeProgram&) = delete;
+
+    NativeProgram(NativeProgram&& o) noexcept
+        : memory(o.memory), mapped(o.mapped), entry(o.entry) {
+        o.memory = nullptr;
+        o.mapped = 0;
+        o.entry = nullptr;
+    }
+
+    NativeProgram& operator=(NativeProgram&& o) noexcept {
+        if (this != &o) {
+            release();
+            std::swap(memory, o.memory);
+            std::swap(mapped, o.mapped);
+            std::swap(entry, o.entry);
+        }
+        return *this;
+    }
+
+    ~NativeProgram() {
+        release();
+    }
+
+    // Translates program to machine code. Returns false, leaving this empty,
+    // when the platform has no JIT, the program loads a binding, or
+    // executable memory is unavailable.
+    bool compile(const Bytecode& program) {
+        release();
+#if defined(GLYPH_JIT)
+        Emitter out;
+        out.code.reserve(program.code.size() * 24 + 32);
+        if (!generate(program, out)) {
+            return false;
+        }
+
+        // Written while writable, then flipped to executable, never both
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t bytes = (out.code.size() + page - 1) / page * page;
+        void* m = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED) {
+            return false;
+        }
+        std::memcpy(m, out.code.data(), out.code.size());
+        if (mprotect(m, bytes, PROT_READ | PROT_EXEC) != 0) {
+            munmap(m, bytes);
+            return false;
+        }
+        memory = m;
+        mapped = bytes;
+        entry = reinterpret_cast<Entry>(m);
+        return true;
+#else
+        (void)program;
+        return false;
+#endif
+    }
+
+    explicit operator bool() const {
+        return entry != nullptr;
+    }
+
+    // Bytes of executable memory held
+    size_t size() const {
+        return mapped;
+    }
+
+    // Runs the program with a scratch stack of at least maxStackDepth + 1
+    // ints. Returns false if an operation failed; the VM reports why.
+    bool run(int* stack, int& result) const {
+        uint64_t r = entry(stack);
+        if (r & FAILED) {
+            return false;
+        }
+        result = static_cast<int>(static_cast<uint32_t>(r));
+        return true;
+    }
+};
+
+// Tiering state shared by a Bytecode and its copies: how often it has run and,
+// once promoted, its native code. Thread-safe; the first caller past the
+// threshold compiles, everyone else keeps using the VM until it is published.
+struct NativeTier {
+    std::atomic<uint32_t> executions{ 0 };
+    std::atomic<bool> attempted{ false };
+    std::atomic<const NativeProgram*> ready{ nullptr };
+    NativeProgram program;
+
+    // Counts one execution; returns the native code once there is some
+    const NativeProgram* promote(const Bytecode& bytecode, uint32_t threshold) {
+        const NativeProgram* native = ready.load(std::memory_order_acquire);
+        if (native != nullptr || attempted.load(std::memory_order_relaxed)) {
+            return native;
+        }
+        if (executions.fetch_add(1, std::memory_order_relaxed) + 1 < threshold
+            || attempted.exchange(true)) {
+            return nullptr;
+        }
+        if (!program.compile(bytecode)) {
+            return nullptr;
+        }
+        ready.store(&program, std::memory_order_release);
+        return &program;
+    }
+};
+
+// ============================================================================
+// Compiler (AST -> Bytecode)
+// ============================================================================
+
+class Compiler {
+private:
+    // Compile-time view of one binding, indexed by binding depth
+    struct Slot {
+        bool nameKnown;
+        int name;
+    };
+
+    Bytecode* program = nullptr;
+    int stackDepth = 0;
+    int bindingDepth = 0;
+    std::vector<Slot> slots;
+
+    int emit(OpCode op, int operand = 0) {
+        program->code.push_back({ op, operand });
+        return static_cast<int>(program->code.size()) - 1;
+    }
+
+    void adjustStack(int delta) {
+        stackDepth += delta;
+        if (stackDepth > program->maxStackDepth) {
+            program->maxStackDepth = stackDepth;
+        }
+    }
+
+    void patch(int at) {
+        program->code[at].operand = static_cast<int>(program->code.size());
+    }
+
+    struct Task {
+        const ASTNode* node;
+        int stage;
+        int label; // instruction to patch once the jump target is known
+    };
+
+    std::vector<Task> tasks;
+
+    // Binding depths are fixed at every instruction, so a variable whose
+    // binder has a constant name, with no computed name bound in between, is
+    // always the same binding slot. Anything else is looked up by name.
+    void emitLoad(int name) {
+        for (size_t i = slots.size(); i-- > 0;) {
+            if (!slots[i].nameKnown) {
+                break;
+            }
+            if (slots[i].name == name) {
+                emit(OpCode::LOAD_SLOT, static_cast<int>(i));
+                return;
+            }
+        }
+        emit(OpCode::LOAD, name);
+    }
+
+    // Emits code for the tree with an explicit work stack, mirroring the
+    // stages of the Evaluator.
+    void compileTree(const ASTNode& root) {
+        tasks.clear();
+        tasks.push_back({ &root, 0, 0 });
+
+        while (!tasks.empty()) {
+            size_t top = tasks.size() - 1;
+            const ASTNode* node = tasks[top].node;
+            int stage = tasks[top].stage++;
+
+            switch (node->type) {
+            case NodeType::VALUE:
+                emit(OpCode::PUSH_UNIT);
+                adjustStack(1);
+                tasks.pop_back();
+                break;
+
+            case NodeType::CONST:
+                emit(OpCode::PUSH_CONST, static_cast<const ConstNode*>(node)->value);
+                adjustStack(1);
+                tasks.pop_back();
+                break;
+
+            case NodeType::VAR:
+                emitLoad(static_cast<const VarNode*>(node)->varIndex);
+                adjustStack(1);
+                tasks.pop_back();
+                break;
+
+            case NodeType::BINARY_OP: {
+                const auto* bin = static_cast<const BinaryOpNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ bin->left, 0, 0 });
+                    break;
+                }
+                if (stage == 1) {
+                    tasks.push_back({ bin->right, 0, 0 });
+                    break;
+                }
+                switch (bin->op) {
+                case '+': emit(OpCode::ADD); break;
+                case '-': emit(OpCode::SUB); break;
+                case '*': emit(OpCode::MUL); break;
+                case '^': emit(OpCode::POW); break;
+                case '%': emit(OpCode::MOD); break;
+                default:
+                    throw std::runtime_error("Unknown operator");
+                }
+                adjustStack(-1);
+                tasks.pop_back();
+                break;
+            }
+
+            case NodeType::LET: {
+                // Same order as the Evaluator: value, then name, both in the
+                // enclosing scope.
+                const auto* let = static_cast<const LetNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ let->value, 0, 0 });
+                }
+                else if (stage == 1) {
+                    tasks.push_back({ let->name, 0, 0 });
+                }
+                else if (stage == 2) {
+                    // Names the Optimizer folded are known here
+                    const ASTNode* name = let->name;
+                    if (name->type == NodeType::CONST) {
+                        slots.push_back({ true, static_cast<const ConstNode*>(name)->value });
+                    }
+                    else {
+                        slots.push_back({ name->type == NodeType::VALUE, 1 });
+                    }
+                    emit(OpCode::BIND);
+                    adjustStack(-2);
+                    if (++bindingDepth > program->maxBindingDepth) {
+                        program->maxBindingDepth = bindingDepth;
+                    }
+                    tasks.push_back({ let->body, 0, 0 });
+                }
+                else {
+                    emit(OpCode::UNBIND);
+                    slots.pop_back();
+                    --bindingDepth;
+                    tasks.pop_back();
+                }
+                break;
+            }
+
+            case NodeType::COND: {
+                const auto* cond = static_cast<const CondNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ cond->condition, 0, 0 });
+                }
+                else if (stage == 1) {
+                    tasks[top].label = emit(OpCode::JUMP_IF_ZERO);
+                    adjustStack(-1);
+                    tasks.push_back({ cond->thenBranch, 0, 0 });
+                }
+                else if (stage == 2) {
+                    int toEnd = emit(OpCode::JUMP);
+                    adjustStack(-1); // only one branch leaves a value
+                    patch(tasks[top].label);
+                    tasks[top].label = toEnd;
+                    tasks.push_back({ cond->elseBranch, 0, 0 });
+                }
+                else {
+                    patch(tasks[top].label);
+                    tasks.pop_back();
+                }
+                break;
+            }
+            }
+        }
+    }
+
+public:
+    Bytecode compile(const ASTNode& root) {
+        Bytecode result;
+        compile(root, result);
+        return result;
+    }
+
+    // Compiles into out, replacing its code but keeping the capacity of its
+    // instruction buffer. out.native is left as it is.
+    void compile(const ASTNode& root, Bytecode& out) {
+        out.code.clear();
+        out.maxStackDepth = 0;
+        out.maxBindingDepth = 0;
+        program = &out;
+        stackDepth = 0;
+        bindingDepth = 0;
+        slots.clear();
+
+        compileTree(root);
+        emit(OpCode::HALT);
+
+        program = nullptr;
+    }
+};
+
+// ============================================================================
+// Virtual Machine
+// ============================================================================
+
+// + - * wrap modulo 2^32, as native code does; ^ and % report overflow and
+// division by zero.
+class VirtualMachine {
+private:
+    struct Binding {
+        int name;
+        int value;
+    };
+
+    std::vector<int> stack;
+    std::vector<Binding> bindings;
+    ExecutionLimits limits;
+
+public:
+    // Step and time limits applied to each execute() call; one step is one
+    // instruction
+    void setLimits(const ExecutionLimits& l) {
+        limits = l;
+    }
+
+    int execute(const Bytecode& program) {
+        return execute(program.view());
+    }
+
+    int execute(const BytecodeView& program) {
+        // Buffers are sized once from the compiler's bounds and reused
+        // across executions.
+        if (stack.size() < static_cast<size_t>(program.maxStackDepth)) {
+            stack.resize(program.maxStackDepth);
+        }
+        if (bindings.size() < static_cast<size_t>(program.maxBindingDepth)) {
+            bindings.resize(program.maxBindingDepth);
+        }
+
+        const Instruction* code = program.code;
+        const Instruction* pc = code;
+        int* sp = stack.data();      // next free stack slot
+        Binding* bp = bindings.data(); // next free binding slot
+        ExecutionBudget budget(limits);
+
+        for (;;) {
+            budget.charge();
+            const Instruction& ins = *pc++;
+            switch (ins.op) {
+            case OpCode::PUSH_UNIT:
+                *sp++ = 1;
+                break;
+            case OpCode::PUSH_CONST:
+                *sp++ = ins.operand;
+                break;
+            case OpCode::ADD:
+                --sp;
+                sp[-1] = static_cast<int>(static_cast<uint32_t>(sp[-1]) + static_cast<uint32_t>(sp[0]));
+                break;
+            case OpCode::SUB:
+                --sp;
+                sp[-1] = static_cast<int>(static_cast<uint32_t>(sp[-1]) - static_cast<uint32_t>(sp[0]));
+                break;
+            case OpCode::MUL:
+                --sp;
+                sp[-1] = static_cast<int>(static_cast<uint32_t>(sp[-1]) * static_cast<uint32_t>(sp[0]));
+                break;
+            case OpCode::POW:
+                --sp;
+                sp[-1] = powInt(sp[-1], sp[0]);
+                break;
+            case OpCode::MOD:
+                --sp;
+                sp[-1] = modInt(sp[-1], sp[0]);
+                break;
+            case OpCode::JUMP:
+                pc = code + ins.operand;
+                break;
+            case OpCode::JUMP_IF_ZERO:
+                if (*--sp == 0) {
+                    pc = code + ins.operand;
+                }
+                break;
+            case OpCode::BIND:
+                sp -= 2;
+                *bp++ = { sp[1], sp[0] };
+                break;
+            case OpCode::UNBIND:
+                --bp;
+                break;
+            case OpCode::LOAD: {
+                // Innermost binding wins, as with Environment::lookup.
+                const Binding* b = bp;
+                do {
+                    if (b == bindings.data()) {
+                        throw std::runtime_error("Unbound variable: " + std::to_string(ins.operand));
+                    }
+                    --b;
+                } while (b->name != ins.operand);
+                *sp++ = b->value;
+                break;
+            }
+            case OpCode::LOAD_SLOT:
+                *sp++ = bindings[ins.operand].value;
+                break;
+            case OpCode::HALT:
+                return sp[-1];
+            }
+        }
+    }
+};
+
+// ============================================================================
+// Lane Evaluation
+// ============================================================================
+
+// Element-wise int32 kernels over n lanes; out may alias either input.
+// Arithmetic wraps, as in the VM.
+using LaneKernel = void (*)(int* out, const int* a, const int* b, size_t n);
+
+// out = mask ? a : b, with mask lanes all ones or zero
+using LaneSelect = void (*)(int* out, const int* mask, const int* a, const int* b, size_t n);
+
+inline void laneAddScalar(int* out, const int* a, const int* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<int>(static_cast<uint32_t>(a[i]) + static_cast<uint32_t>(b[i]));
+    }
+}
+
+inline void laneSubScalar(int* out, const int* a, const int* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<int>(static_cast<uint32_t>(a[i]) - static_cast<uint32_t>(b[i]));
+    }
+}
+
+inline void laneMulScalar(int* out, const int* a, const int* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<int>(static_cast<uint32_t>(a[i]) * static_cast<uint32_t>(b[i]));
+    }
+}
+
+inline void laneSelectScalar(int* out, const int* mask, const int* a, const int* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (a[i] & mask[i]) | (b[i] & ~mask[i]);
+    }
+}
+
+#if defined(GLYPH_SIMD_X86)
+
+inline __m128i loadLanes128(const int* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+inline void storeLanes128(int* p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+inline void laneAddSse2(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        storeLanes128(out + i, _mm_add_epi32(loadLanes128(a + i), loadLanes128(b + i)));
+    }
+    laneAddScalar(out + i, a + i, b + i, n - i);
+}
+
+inline void laneSubSse2(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        storeLanes128(out + i, _mm_sub_epi32(loadLanes128(a + i), loadLanes128(b + i)));
+    }
+    laneSubScalar(out + i, a + i, b + i, n - i);
+}
+
+// SSE2 has no 32-bit multiply-low: even and odd lanes go through the 64-bit
+// unsigned multiply (whose low half is the wrapped signed product) and are
+// interleaved back.
+inline void laneMulSse2(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = loadLanes128(a + i);
+        __m128i y = loadLanes128(b + i);
+        __m128i even = _mm_mul_epu32(x, y);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+        storeLanes128(out + i, _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))));
+    }
+    laneMulScalar(out + i, a + i, b + i, n - i);
+}
+
+inline void laneSelectSse2(int* out, const int* mask, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i m = loadLanes128(mask + i);
+        storeLanes128(out + i, _mm_or_si128(_mm_and_si128(m, loadLanes128(a + i)),
+            _mm_andnot_si128(m, loadLanes128(b + i))));
+    }
+    laneSelectScalar(out + i, mask + i, a + i, b + i, n - i);
+}
+
+GLYPH_TARGET_AVX2
+inline void laneAddAvx2(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi32(x, y));
+    }
+    laneAddScalar(out + i, a + i, b + i, n - i);
+}
+
+GLYPH_TARGET_AVX2
+inline void laneSubAvx2(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi32(x, y));
+    }
+    laneSubScalar(out + i, a + i, b + i, n - i);
+}
+
+GLYPH_TARGET_AVX2
+inline void laneMulAvx2(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_mullo_epi32(x, y));
+    }
+    laneMulScalar(out + i, a + i, b + i, n - i);
+}
+
+GLYPH_TARGET_AVX2
+inline void laneSelectAvx2(int* out, const int* mask, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i));
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_blendv_epi8(y, x, m));
+    }
+    laneSelectScalar(out + i, mask + i, a + i, b + i, n - i);
+}
+
+#elif defined(GLYPH_SIMD_NEON)
+
+inline void laneAddNeon(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(out + i, vaddq_s32(vld1q_s32(a + i), vld1q_s32(b + i)));
+    }
+    laneAddScalar(out + i, a + i, b + i, n - i);
+}
+
+inline void laneSubNeon(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(out + i, vsubq_s32(vld1q_s32(a + i), vld1q_s32(b + i)));
+    }
+    laneSubScalar(out + i, a + i, b + i, n - i);
+}
+
+inline void laneMulNeon(int* out, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_s32(out + i, vmulq_s32(vld1q_s32(a + i), vld1q_s32(b + i)));
+    }
+    laneMulScalar(out + i, a + i, b + i, n - i);
+}
+
+inline void laneSelectNeon(int* out, const int* mask, const int* a, const int* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t m = vreinterpretq_u32_s32(vld1q_s32(mask + i));
+        vst1q_s32(out + i, vbslq_s32(m, vld1q_s32(a + i), vld1q_s32(b + i)));
+    }
+    laneSelectScalar(out + i, mask + i, a + i, b + i, n - i);
+}
+
+#endif
+
+struct LaneKernels {
+    LaneKernel add;
+    LaneKernel sub;
+    LaneKernel mul;
+    LaneSelect select;
+    const char* name;
+};
+
+inline LaneKernels selectLaneKernels() {
+#if defined(GLYPH_SIMD_X86)
+    if (cpuHasAvx2()) {
+        return { laneAddAvx2, laneSubAvx2, laneMulAvx2, laneSelectAvx2, "avx2" };
+    }
+    return { laneAddSse2, laneSubSse2, laneMulSse2, laneSelectSse2, "sse2" };
+#elif defined(GLYPH_SIMD_NEON)
+    return { laneAddNeon, laneSubNeon, laneMulNeon, laneSelectNeon, "neon" };
+#else
+    return { laneAddScalar, laneSubScalar, laneMulScalar, laneSelectScalar, "scalar" };
+#endif
+}
+
+inline const LaneKernels& activeLaneKernels() {
+    static const LaneKernels kernels = selectLaneKernels();
+    return kernels;
+}
+
+// Name of the kernels LaneEvaluator dispatches to ("avx2", "sse2", "neon",
+// "scalar")
+inline const char* laneKernelName() {
+    return activeLaneKernels().name;
+}
+
+// Evaluates one int32 tree for many environments at once. Lane i binds each
+// input column's name to its i-th value, and its result equals evaluating the
+// tree in that environment alone. Lanes are processed in blocks of BLOCK;
+// every node runs over a whole block, with + - * on the SIMD kernels. Each
+// conditional splits the block's active-lane mask: both branches run, under
+// complementary masks, and are blended. A branch with no active lanes is
+// skipped. ^ and % and variable lookups run lane by lane, on active lanes
+// only. A lane that fails drops out of every mask, so it ends on the same
+// error the scalar evaluator would throw, and the other lanes carry on.
+class LaneEvaluator {
+public:
+    static constexpr size_t BLOCK = 128;
+
+    // Free variable `name`, with one value per lane
+    struct Column {
+        int name;
+        const int* values;
+    };
+
+    struct Results {
+        std::vector<int> values;                            // 0 in failed lanes
+        std::vector<std::pair<size_t, std::string>> errors; // failed lanes in order, with messages
+
+        bool failed(size_t lane) const {
+            auto it = std::lower_bound(errors.begin(), errors.end(), lane,
+                [](const std::pair<size_t, std::string>& e, size_t l) { return e.first < l; });
+            return it != errors.end() && it->first == lane;
+        }
+    };
+
+private:
+    struct Task {
+        const ASTNode* node;
+        int stage;
+    };
+
+    // A let binding in scope: value stack slots holding its name and value
+    struct Frame {
+        size_t name;
+        size_t value;
+    };
+
+    std::vector<Task> tasks;
+    std::vector<int> values; // value stack, BLOCK ints per slot
+    size_t valueCount = 0;
+    std::vector<int> masks;  // mask stack, one slot per enclosing branch
+    std::vector<bool> live;  // whether each mask has an active lane
+    std::vector<Frame> frames;
+    std::vector<std::pair<size_t, std::string>> blockErrors;
+
+    const std::vector<Column>* inputs = nullptr;
+    size_t base = 0;  // first lane of the block
+    size_t width = 0; // lanes in the block
+
+    int* slot(size_t k) {
+        return values.data() + k * BLOCK;
+    }
+
+    int* mask(size_t k) {
+        return masks.data() + k * BLOCK;
+    }
+
+    size_t push() {
+        if ((valueCount + 1) * BLOCK > values.size()) {
+            values.resize(std::max(values.size() * 2, 16 * BLOCK));
+        }
+        return valueCount++;
+    }
+
+    // Pushes a mask of the lanes in the current mask where cond is nonzero
+    // (or zero, if !taken)
+    void pushMask(const int* cond, bool taken) {
+        size_t k = live.size();
+        if ((k + 1) * BLOCK > masks.size()) {
+            masks.resize((k + 1) * BLOCK * 2);
+        }
+        const int* outer = mask(k - 1);
+        int* m = mask(k);
+        bool any = false;
+        for (size_t i = 0; i < width; i++) {
+            m[i] = (cond[i] != 0) == taken ? outer[i] : 0;
+            any |= m[i] != 0;
+        }
+        live.push_back(any);
+    }
+
+    void popMask() {
+        live.pop_back();
+    }
+
+    void fail(size_t lane, const char* message) {
+        blockErrors.emplace_back(base + lane, message);
+        for (size_t k = 0; k < live.size(); k++) {
+            mask(k)[lane] = 0;
+        }
+    }
+
+    const int* lookup(int name, size_t lane) {
+        for (size_t f = frames.size(); f-- > 0;) {
+            if (slot(frames[f].name)[lane] == name) {
+                return &slot(frames[f].value)[lane];
+            }
+        }
+        for (size_t c = inputs->size(); c-- > 0;) {
+            if ((*inputs)[c].name == name) {
+                return &(*inputs)[c].values[base + lane];
+            }
+        }
+        return nullptr;
+    }
+
+    void loadVar(int name, int* out) {
+        if (frames.empty()) {
+            // Only the inputs are in scope: the column is the answer
+            for (size_t c = inputs->size(); c-- > 0;) {
+                if ((*inputs)[c].name == name) {
+                    std::memcpy(out, (*inputs)[c].values + base, width * sizeof(int));
+                    return;
+                }
+            }
+        }
+        const int* m = mask(live.size() - 1);
+        std::string message;
+        for (size_t i = 0; i < width; i++) {
+            if (m[i] == 0) {
+                continue;
+            }
+            const int* value = lookup(name, i);
+            if (value != nullptr) {
+                out[i] = *value;
+                continue;
+            }
+            if (message.empty()) {
+                message = "Unbound variable: " + std::to_string(name);
+            }
+            fail(i, message.c_str());
+        }
+    }
+
+    // a = a op b over the block
+    void apply(char op, int* a, const int* b) {
+        const LaneKernels& k = activeLaneKernels();
+        switch (op) {
+        case '+': k.add(a, a, b, width); return;
+        case '-': k.sub(a, a, b, width); return;
+        case '*': k.mul(a, a, b, width); return;
+        case '^':
+        case '%':
+            break;
+        default:
+            throw std::runtime_error("Unknown operator");
+        }
+
+        const int* m = mask(live.size() - 1);
+        for (size_t i = 0; i < width; i++) {
+            if (m[i] == 0) {
+                continue;
+            }
+            GlyphError error = op == '^' ? powStatus(a[i], b[i], a[i]) : modStatus(a[i], b[i], a[i]);
+            if (error != GlyphError::NONE) {
+                fail(i, glyphErrorMessage(error, op).c_str());
+            }
+        }
+    }
+
+    void evaluateBlock(const ASTNode& root) {
+        tasks.clear();
+        frames.clear();
+        valueCount = 0;
+        live.assign(1, true);
+        if (masks.size() < BLOCK) {
+            masks.resize(BLOCK);
+        }
+        std::fill(masks.begin(), masks.begin() + BLOCK, 0);
+        std::fill(masks.begin(), masks.begin() + width, -1);
+        tasks.push_back({ &root, 0 });
+
+        while (!tasks.empty()) {
+            size_t top = tasks.size() - 1;
+            const ASTNode* node = tasks[top].node;
+            int stage = tasks[top].stage++;
+
+            if (stage == 0 && !live.back()) {
+                // No lane reaches this node
+                std::fill_n(slot(push()), width, 0);
+                tasks.pop_back();
+                continue;
+            }
+
+            switch (node->type) {
+            case NodeType::VALUE:
+                std::fill_n(slot(push()), width, 1);
+                tasks.pop_back();
+                break;
+
+            case NodeType::CONST:
+                std::fill_n(slot(push()), width, static_cast<const ConstNode*>(node)->value);
+                tasks.pop_back();
+                break;
+
+            case NodeType::VAR: {
+                size_t k = push();
+                loadVar(static_cast<const VarNode*>(node)->varIndex, slot(k));
+                tasks.pop_back();
+                break;
+            }
+
+            case NodeType::BINARY_OP: {
+                const auto* bin = static_cast<const BinaryOpNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ bin->left, 0 });
+                }
+                else if (stage == 1) {
+                    tasks.push_back({ bin->right, 0 });
+                }
+                else {
+                    apply(bin->op, slot(valueCount - 2), slot(valueCount - 1));
+                    valueCount--;
+                    tasks.pop_back();
+                }
+                break;
+            }
+
+            case NodeType::LET: {
+                // Value first, then name, as in the Evaluator; both stay on
+                // the value stack as the frame while the body runs
+                const auto* let = static_cast<const LetNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ let->value, 0 });
+                }
+                else if (stage == 1) {
+                    tasks.push_back({ let->name, 0 });
+                }
+                else if (stage == 2) {
+                    frames.push_back({ valueCount - 1, valueCount - 2 });
+                    tasks.push_back({ let->body, 0 });
+                }
+                else {
+                    frames.pop_back();
+                    std::memcpy(slot(valueCount - 3), slot(valueCount - 1), width * sizeof(int));
+                    valueCount -= 2;
+                    tasks.pop_back();
+                }
+                break;
+            }
+
+            case NodeType::COND: {
+                // Stack: condition, then value, else value; all three are
+                // merged into the condition's slot at the end
+                const auto* cond = static_cast<const CondNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ cond->condition, 0 });
+                }
+                else if (stage == 1) {
+                    pushMask(slot(valueCount - 1), true);
+                    tasks.push_back({ cond->thenBranch, 0 });
+                }
+                else if (stage == 2) {
+                    popMask();
+                    pushMask(slot(valueCount - 2), false);
+                    tasks.push_back({ cond->elseBranch, 0 });
+                }
+                else {
+                    size_t c = valueCount - 3;
+                    activeLaneKernels().select(slot(c), mask(live.size() - 1), slot(c + 2), slot(c + 1), width);
+                    popMask();
+                    valueCount -= 2;
+                    tasks.pop_back();
+                }
+                break;
+            }
+            }
+        }
+    }
+
+public:
+    // Evaluates root in `lanes` environments; lane i binds inputs[j].name to
+    // inputs[j].values[i] (later columns shadow earlier ones with the same
+    // name). Lane failures are reported in the results, never thrown.
+    Results evaluate(const ASTNode& root, size_t lanes, const std::vector<Column>& columns) {
+        Results results;
+        results.values.resize(lanes);
+        inputs = &columns;
+
+        for (base = 0; base < lanes; base += BLOCK) {
+            width = std::min(BLOCK, lanes - base);
+            blockErrors.clear();
+            evaluateBlock(root);
+
+            const int* result = slot(0);
+            const int* alive = mask(0);
+            for (size_t i = 0; i < width; i++) {
+                results.values[base + i] = result[i] & alive[i];
+            }
+            // Failures arrive in evaluation order; each lane fails once
+            std::sort(blockErrors.begin(), blockErrors.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (auto& e : blockErrors) {
+                results.errors.push_back(std::move(e));
+            }
+        }
+
+        inputs = nullptr;
+        return results;
+    }
+};
+
+// ============================================================================
+// Program Cache
+// ============================================================================
+
+// 64-bit hash of a program's source, eight bytes per step
+inline uint64_t hashSource(std::string_view source) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = source.size() * k;
+    size_t i = 0;
+    for (; i + 8 <= source.size(); i += 8) {
+        uint64_t w;
+        std::memcpy(&w, source.data() + i, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 29;
+    }
+    if (i < source.size()) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, source.data() + i, source.size() - i);
+        h = (h ^ tail) * k;
+    }
+    return h ^ (h >> 32);
+}
+
+// Bounded LRU map from program source to its compiled forms and, optionally,
+// its results. Every program the parser accepts is closed and pure, so its
+// result under a given backend never changes. Sources are compared in full,
+// so a hash collision costs a miss, never a wrong answer. Thread-safe;
+// artifacts are shared_ptrs, so an evicted program stays alive for whoever
+// is still running it.
+class ProgramCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    // What is known about a program under one backend; any part may be
+    // missing
+    struct Record {
+        std::shared_ptr<const Bytecode> bytecode; // int32 programs
+        std::shared_ptr<const PackedAST> packed;  // other backends
+        bool failed = false;       // the source does not compile; text is the error
+        bool hasResult = false;
+        bool resultFailed = false; // evaluation failed; text is the error
+        std::string text;
+    };
+
+private:
+    // Rough per-entry cost of the list and index nodes
+    static constexpr size_t ENTRY_OVERHEAD = 64;
+
+    struct Result {
+        bool known = false;
+        bool failed = false;
+        std::string text;
+    };
+
+    struct Entry {
+        std::string source;
+        uint64_t hash;
+        std::shared_ptr<const Bytecode> bytecode;
+        std::shared_ptr<const PackedAST> packed;
+        bool failed = false;
+        std::string error;
+        Result results[NUMERIC_BACKEND_COUNT];
+        size_t bytes = 0;
+    };
+
+    struct Key {
+        uint64_t hash;
+        std::string_view source;
+
+        bool operator==(const Key& o) const {
+            return hash == o.hash && source == o.source;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return static_cast<size_t>(k.hash); }
+    };
+
+    using EntryList = std::list<Entry>;
+
+    mutable std::mutex mutex;
+    EntryList lru; // most recently used first
+    std::unordered_map<Key, EntryList::iterator, KeyHash> index;
+    size_t budget = 0;
+    size_t used = 0;
+    Stats counters;
+
+    static size_t footprint(const Entry& e) {
+        size_t bytes = sizeof(Entry) + ENTRY_OVERHEAD + e.source.capacity() + e.error.capacity();
+        if (e.bytecode) {
+            bytes += sizeof(Bytecode) + e.bytecode->code.capacity() * sizeof(Instruction);
+        }
+        if (e.packed) {
+            bytes += sizeof(PackedAST) + e.packed->code.capacity();
+        }
+        for (const Result& r : e.results) {
+            bytes += r.text.capacity();
+        }
+        return bytes;
+    }
+
+    void evictToBudget() {
+        while (used > budget && !lru.empty()) {
+            Entry& victim = lru.back();
+            index.erase({ victim.hash, victim.source });
+            used -= victim.bytes;
+            lru.pop_back();
+            counters.evictions++;
+        }
+    }
+
+    // Finds or creates the entry for source and moves it to the front
+    Entry& touch(uint64_t hash, std::string_view source) {
+        auto it = index.find({ hash, source });
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return lru.front();
+        }
+        lru.emplace_front();
+        Entry& e = lru.front();
+        e.source.assign(source.data(), source.size());
+        e.hash = hash;
+        index.emplace(Key{ hash, e.source }, lru.begin());
+        return e;
+    }
+
+    // Re-measures e after it changed, then trims the cache
+    void update(Entry& e) {
+        used -= e.bytes;
+        e.bytes = footprint(e);
+        used += e.bytes;
+        evictToBudget();
+    }
+
+public:
+    // Memory the cache may use, in bytes (0 = disabled, the default).
+    // Shrinking evicts immediately.
+    void setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        evictToBudget();
+    }
+
+    bool enabled() const {
+        return budget != 0;
+    }
+
+    // Drops every entry and zeroes the counters; the budget is kept
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        index.clear();
+        lru.clear();
+        used = 0;
+        counters = Stats();
+    }
+
+    // A hit is a lookup that finds what the caller needs: a compile error,
+    // the compiled form for backend, or (if wantResult) a stored result.
+    Record lookup(uint64_t hash, std::string_view source, NumericBackend backend, bool wantResult) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Record hit;
+        auto it = index.find({ hash, source });
+        if (it == index.end()) {
+            counters.misses++;
+            return hit;
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        const Entry& e = lru.front();
+
+        const Result& r = e.results[static_cast<size_t>(backend)];
+        if (e.failed) {
+            hit.failed = true;
+            hit.text = e.error;
+        }
+        else if (wantResult && r.known) {
+            hit.hasResult = true;
+            hit.resultFailed = r.failed;
+            hit.text = r.text;
+        }
+        hit.bytecode = e.bytecode;
+        hit.packed = e.packed;
+
+        bool found = hit.failed || hit.hasResult ||
+            (backend == NumericBackend::INT32 ? hit.bytecode != nullptr : hit.packed != nullptr);
+        if (found) {
+            counters.hits++;
+        }
+        else {
+            counters.misses++;
+        }
+        return hit;
+    }
+
+    // Merges whatever learned holds into the entry for source
+    void store(uint64_t hash, std::string_view source, NumericBackend backend, const Record& learned) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& e = touch(hash, source);
+        if (learned.failed) {
+            e.failed = true;
+            e.error = learned.text;
+        }
+        if (learned.bytecode) {
+            e.bytecode = learned.bytecode;
+        }
+        if (learned.packed) {
+            e.packed = learned.packed;
+        }
+        if (learned.hasResult) {
+            Result& r = e.results[static_cast<size_t>(backend)];
+            r.known = true;
+            r.failed = learned.resultFailed;
+            r.text = learned.text;
+        }
+        update(e);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats s = counters;
+        s.entries = lru.size();
+        s.bytes = used;
+        return s;
+    }
+};
+
+// ============================================================================
+// Bytecode Files
+// ============================================================================
+
+// Compiled int32 programs saved to disk, so loading skips validation, lexing,
+// parsing and optimization. Layout, all integers little-endian:
+//
+//   0   "GLYB"
+//   4   u32 format version (BYTECODE_FILE_VERSION)
+//   8   u64 instruction count
+//   16  u32 maximum stack depth
+//   20  u32 maximum binding depth
+//   24  u64 checksum of bytes 0-23 and the instruction records
+//   32  instruction records: u8 opcode, 3 zero bytes, i32 operand
+//
+// The depths are those the code reaches, which load() checks: a file cannot
+// make the VM reserve more than its instructions need.
+//
+// A record has Instruction's own layout, so on little-endian hosts a mapped
+// file is executed where it lies, with nothing allocated per instruction.
+inline constexpr uint32_t BYTECODE_FILE_VERSION = 2;
+inline constexpr size_t BYTECODE_HEADER_BYTES = 32;
+inline constexpr size_t BYTECODE_RECORD_BYTES = 8;
+
+// Writes bytecode files, and loads one checked and ready to execute. Where
+// the host layout allows, view() points into the image itself, which must
+// then outlive this object; otherwise the instructions are decoded into a
+// private copy.
+class BytecodeFile {
+private:
+    std::vector<Instruction> decoded;
+    BytecodeView program;
+    bool inPlace = false;
+
+    static void put(std::string& out, uint64_t v, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            out += static_cast<char>(v >> (8 * i));
+        }
+    }
+
+    static uint64_t get(const char* p, size_t bytes) {
+        uint64_t v = 0;
+        for (size_t i = bytes; i-- > 0;) {
+            v = (v << 8) | static_cast<unsigned char>(p[i]);
+        }
+        return v;
+    }
+
+    // Covers the header as well as the records, so no field can be edited
+    // unnoticed
+    static uint64_t checksum(std::string_view header, std::string_view records) {
+        return hashSource(records) ^ (hashSource(header.substr(0, 24)) * 0x9E3779B97F4A7C15ull);
+    }
+
+    [[noreturn]] static void invalid(const std::string& why) {
+        throw std::runtime_error("Invalid bytecode file: " + why);
+    }
+
+    static bool nativeLayout() {
+        const uint32_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1 && sizeof(Instruction) == BYTECODE_RECORD_BYTES
+            && offsetof(Instruction, operand) == 4 && sizeof(OpCode) == 1;
+    }
+
+    // Proves the VM can run program without reading or writing out of bounds:
+    // every opcode is known, jumps go forward to an instruction, each
+    // instruction is reached with one stack and binding depth, the deepest of
+    // which are exactly the declared maxima, and control ends in HALT. The
+    // compiler only emits such code.
+    static void verify(const BytecodeView& program) {
+        const size_t n = program.size;
+        std::vector<int> stackAt(n, -1);
+        std::vector<int> bindAt(n, 0);
+        int depth = 0;
+        int bind = 0;
+        int deepestStack = 0;
+        int deepestBind = 0;
+        bool live = true; // reached by falling through
+
+        auto join = [&](size_t target, int d, int b) {
+            if (stackAt[target] >= 0 && (stackAt[target] != d || bindAt[target] != b)) {
+                invalid("inconsistent stack depth at instruction " + std::to_string(target));
+            }
+            stackAt[target] = d;
+            bindAt[target] = b;
+        };
+
+        for (size_t pc = 0; pc < n; pc++) {
+            if (live) {
+                join(pc, depth, bind);
+            }
+            else if (stackAt[pc] < 0) {
+                invalid("unreachable instruction " + std::to_string(pc));
+            }
+            depth = stackAt[pc];
+            bind = bindAt[pc];
+            live = true;
+
+            const Instruction& ins = program.code[pc];
+            int pops = 0;
+            int pushes = 0;
+            switch (ins.op) {
+            case OpCode::PUSH_UNIT:
+            case OpCode::PUSH_CONST:
+            case OpCode::LOAD:
+                pushes = 1;
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+            case OpCode::POW:
+            case OpCode::MOD:
+                pops = 2;
+                pushes = 1;
+                break;
+            case OpCode::JUMP:
+            case OpCode::JUMP_IF_ZERO:
+                pops = ins.op == OpCode::JUMP_IF_ZERO ? 1 : 0;
+                if (ins.operand <= static_cast<int64_t>(pc) || static_cast<size_t>(ins.operand) >= n) {
+                    invalid("jump out of range at instruction " + std::to_string(pc));
+                }
+                break;
+            case OpCode::BIND:
+                pops = 2;
+                break;
+            case OpCode::UNBIND:
+                if (bind == 0) {
+                    invalid("unbind without a binding at instruction " + std::to_string(pc));
+                }
+                bind--;
+                break;
+            case OpCode::LOAD_SLOT:
+                if (ins.operand < 0 || ins.operand >= bind) {
+                    invalid("slot out of range at instruction " + std::to_string(pc));
+                }
+                pushes = 1;
+                break;
+            case OpCode::HALT:
+                pops = 1;
+                break;
+            default:
+                invalid("unknown opcode at instruction " + std::to_string(pc));
+            }
+
+            if (depth < pops) {
+                invalid("stack underflow at instruction " + std::to_string(pc));
+            }
+            depth += pushes - pops;
+            if (ins.op == OpCode::BIND) {
+                bind++;
+            }
+            if (depth > program.maxStackDepth || bind > program.maxBindingDepth) {
+                invalid("stack deeper than declared at instruction " + std::to_string(pc));
+            }
+            deepestStack = std::max(deepestStack, depth);
+            deepestBind = std::max(deepestBind, bind);
+
+            if (ins.op == OpCode::JUMP || ins.op == OpCode::JUMP_IF_ZERO) {
+                join(static_cast<size_t>(ins.operand), depth, bind);
+            }
+            if (ins.op == OpCode::JUMP || ins.op == OpCode::HALT) {
+                live = false;
+            }
+        }
+        if (live) {
+            invalid("code runs past its end");
+        }
+        if (deepestStack != program.maxStackDepth || deepestBind != program.maxBindingDepth) {
+            invalid("declared stack depth is not the one the code reaches");
+        }
+    }
+
+public:
+    // Serializes a compiled program in the bytecode file format
+    static std::string encode(const Bytecode& program) {
+        std::string records;
+        records.reserve(program.code.size() * BYTECODE_RECORD_BYTES);
+        for (const Instruction& ins : program.code) {
+            put(records, static_cast<uint8_t>(ins.op), 4);
+            put(records, static_cast<uint32_t>(ins.operand), 4);
+        }
+
+        std::string out = "GLYB";
+        put(out, BYTECODE_FILE_VERSION, 4);
+        put(out, program.code.size(), 8);
+        put(out, static_cast<uint32_t>(program.maxStackDepth), 4);
+        put(out, static_cast<uint32_t>(program.maxBindingDepth), 4);
+        put(out, checksum(out, records), 8);
+        out += records;
+        return out;
+    }
+
+    // Throws std::runtime_error if image is not a valid bytecode file of
+    // this version
+    void load(std::string_view image) {
+        decoded.clear();
+        program = BytecodeView();
+        inPlace = false;
+
+        if (image.size() < BYTECODE_HEADER_BYTES || image.compare(0, 4, "GLYB") != 0) {
+            invalid("not a Glyph bytecode file");
+        }
+        const char* p = image.data();
+        uint64_t version = get(p + 4, 4);
+        if (version != BYTECODE_FILE_VERSION) {
+            invalid("format version " + std::to_string(version) + ", expected " + std::to_string(BYTECODE_FILE_VERSION));
+        }
+        uint64_t count = get(p + 8, 8);
+        uint64_t maxStack = get(p + 16, 4);
+        uint64_t maxBind = get(p + 20, 4);
+        if (count == 0 || count > (image.size() - BYTECODE_HEADER_BYTES) / BYTECODE_RECORD_BYTES
+            || image.size() != BYTECODE_HEADER_BYTES + count * BYTECODE_RECORD_BYTES) {
+            invalid("truncated or oversized");
+        }
+        if (maxStack > count || maxBind > count) {
+            invalid("stack depth out of range");
+        }
+        std::string_view records = image.substr(BYTECODE_HEADER_BYTES);
+        if (checksum(image, records) != get(p + 24, 8)) {
+            invalid("checksum mismatch");
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (get(records.data() + i * BYTECODE_RECORD_BYTES + 1, 3) != 0) {
+                invalid("nonzero padding in instruction " + std::to_string(i));
+            }
+        }
+
+        program.size = static_cast<size_t>(count);
+        program.maxStackDepth = static_cast<int>(maxStack);
+        program.maxBindingDepth = static_cast<int>(maxBind);
+        if (nativeLayout() && reinterpret_cast<uintptr_t>(records.data()) % alignof(Instruction) == 0) {
+            program.code = reinterpret_cast<const Instruction*>(records.data());
+            inPlace = true;
+        }
+        else {
+            decoded.resize(program.size);
+            for (size_t i = 0; i < program.size; i++) {
+                const char* r = records.data() + i * BYTECODE_RECORD_BYTES;
+                decoded[i].op = static_cast<OpCode>(get(r, 1));
+                decoded[i].operand = static_cast<int>(static_cast<uint32_t>(get(r + 4, 4)));
+            }
+            program.code = decoded.data();
+        }
+        verify(program);
+    }
+
+    const BytecodeView& view() const {
+        return program;
+    }
+
+    // Whether view() executes the image directly
+    bool executesInPlace() const {
+        return inPlace;
+    }
+};
+
+// ============================================================================
+// Incremental Programs
+// ============================================================================
+
+// A parsed program that can be edited in place. Each node's text length,
+// subtree size and last value (or error) are kept in a side table. An edit
+// re-parses only the smallest subtree that encloses it, and rebuilds the
+// ancestors above that subtree, reusing every sibling subtree. The next
+// evaluate() then recomputes only the new nodes and that path.
+//
+// Parsed programs never read a binding, so a subtree's value does not
+// depend on where it sits, and it can be kept across edits.
+template <typename Backend>
+class BasicIncrementalProgram {
+public:
+    using Value = typename Backend::Value;
+
+    // A node's text within source(): [offset, offset + length)
+    struct Subtree {
+        size_t offset;
+        size_t length;
+    };
+
+private:
+    struct NodeInfo {
+        size_t length; // bytes of source text
+        size_t nodes;  // nodes in the subtree
+        bool known = false;
+        bool failed = false;
+        Value value{};
+        std::string error;
+    };
+
+    // A node on the way from the root to an edit, and where it starts
+    struct Step {
+        const ASTNode* node;
+        size_t offset;
+        int childIndex; // index of the next step's node among this one's children
+    };
+
+    Arena arena;
+    const ASTNode* root = nullptr;
+    std::unordered_map<const ASTNode*, NodeInfo> infos;
+    size_t maxDepth;
+    size_t compactThreshold = 0;
+    size_t lastReparsed = 0;
+    size_t lastEvaluated = 0;
+
+    static constexpr size_t MIN_COMPACT_BYTES = 1 << 20;
+
+    const NodeInfo& info(const ASTNode* node) const {
+        return infos.find(node)->second;
+    }
+
+    // Adds side-table entries for the nodes under node that have none yet
+    void describe(const ASTNode* node) {
+        std::vector<std::pair<const ASTNode*, bool>> stack{ { node, false } };
+        while (!stack.empty()) {
+            auto [n, expanded] = stack.back();
+            stack.pop_back();
+            if (infos.count(n) != 0) {
+                continue;
+            }
+            const ASTNode* kids[3];
+            int count = astChildren(n, kids);
+            if (!expanded) {
+                stack.push_back({ n, true });
+                for (int i = 0; i < count; i++) {
+                    stack.push_back({ kids[i], false });
+                }
+                continue;
+            }
+            NodeInfo ni;
+            ni.length = count == 0 ? 1 : 3; // "_", or "(", the operator and ")"
+            ni.nodes = 1;
+            for (int i = 0; i < count; i++) {
+                const NodeInfo& c = info(kids[i]);
+                ni.length += c.length;
+                ni.nodes += c.nodes;
+            }
+            infos.emplace(n, std::move(ni));
+        }
+    }
+
+    // Drops the side-table entries of a subtree that is no longer reachable
+    void forget(const ASTNode* node) {
+        std::vector<const ASTNode*> stack{ node };
+        while (!stack.empty()) {
+            const ASTNode* n = stack.back();
+            stack.pop_back();
+            if (n == ValueNode::instance()) {
+                continue; // shared by every program
+            }
+            infos.erase(n);
+            const ASTNode* kids[3];
+            int count = astChildren(n, kids);
+            stack.insert(stack.end(), kids, kids + count);
+        }
+    }
+
+    static std::string text(const ASTNode* node) {
+        std::string out;
+        std::vector<const ASTNode*> stack{ node }; // nullptr closes a bracket
+        while (!stack.empty()) {
+            const ASTNode* n = stack.back();
+            stack.pop_back();
+            if (n == nullptr) {
+                out += ')';
+                continue;
+            }
+            switch (n->type) {
+            case NodeType::VALUE:
+                out += '_';
+                continue;
+            case NodeType::BINARY_OP:
+                out += '(';
+                out += static_cast<const BinaryOpNode*>(n)->op;
+                break;
+            case NodeType::LET:
+                out += "(:";
+                break;
+            case NodeType::COND:
+                out += "(%";
+                break;
+            default:
+                throw std::runtime_error("Unsupported node in incremental program");
+            }
+            const ASTNode* kids[3];
+            int count = astChildren(n, kids);
+            stack.push_back(nullptr);
+            for (int i = count; i-- > 0;) {
+                stack.push_back(kids[i]);
+            }
+        }
+        return out;
+    }
+
+    // Parses source as exactly one expression whose nodes sit `depth` levels
+    // below the root
+    const ASTNode* parseSpan(std::string_view source, size_t depth) {
+        SourceScan scan = scanSource(source);
+        if (scan.invalidOffset != std::string_view::npos) {
+            throw std::runtime_error(std::string("Invalid character: ") + source[scan.invalidOffset]);
+        }
+        if (maxDepth != 0 && scan.maxDepth + depth > maxDepth) {
+            throw std::runtime_error("Maximum nesting depth of " + std::to_string(maxDepth) + " exceeded");
+        }
+        Lexer lexer(source);
+        Parser parser(lexer, arena, 0);
+        parser.reserve(scan.maxDepth);
+        const ASTNode* node = parser.parseExpression();
+        if (lexer.peek() != '\0') {
+            throw std::runtime_error(std::string("Unexpected character after expression: ") + lexer.peek());
+        }
+        return node;
+    }
+
+    // Would the parent's text still parse with child at index replaced? Only
+    // '%' looks ahead: its first operand decides modulo ('_') or conditional.
+    static bool fits(const ASTNode* parent, int index, const ASTNode* child) {
+        if (index != 0) {
+            return true;
+        }
+        if (parent->type == NodeType::COND) {
+            return child->type != NodeType::VALUE;
+        }
+        if (parent->type == NodeType::BINARY_OP && static_cast<const BinaryOpNode*>(parent)->op == '%') {
+            return child->type == NodeType::VALUE;
+        }
+        return true;
+    }
+
+    const ASTNode* withChild(const ASTNode* node, int index, const ASTNode* child) {
+        const ASTNode* kids[3];
+        astChildren(node, kids);
+        kids[index] = child;
+        switch (node->type) {
+        case NodeType::BINARY_OP:
+            return arena.make<BinaryOpNode>(static_cast<const BinaryOpNode*>(node)->op, kids[0], kids[1]);
+        case NodeType::LET:
+            return arena.make<LetNode>(kids[0], kids[1], kids[2]);
+        default:
+            return arena.make<CondNode>(kids[0], kids[1], kids[2]);
+        }
+    }
+
+    // Path from the root to the innermost node whose text contains the
+    // range; an insertion (length 0) must fall strictly inside it
+    std::vector<Step> locate(size_t offset, size_t length) const {
+        std::vector<Step> path{ { root, 0, -1 } };
+        for (;;) {
+            Step& step = path.back();
+            const ASTNode* kids[3];
+            int count = astChildren(step.node, kids);
+            size_t start = step.offset + 2;
+            int next = -1;
+            for (int i = 0; i < count; i++) {
+                size_t end = start + info(kids[i]).length;
+                bool inside = length == 0 ? start < offset && offset < end : start <= offset && offset + length <= end;
+                if (inside) {
+                    next = i;
+                    break;
+                }
+                start = end;
+            }
+            if (next < 0) {
+                return path;
+            }
+            step.childIndex = next;
+            path.push_back({ kids[next], start, -1 });
+        }
+    }
+
+    // Copies the live tree into a fresh arena once edits have left enough
+    // garbage behind
+    void compactIfNeeded() {
+        if (arena.capacity() <= compactThreshold) {
+            return;
+        }
+        Arena fresh;
+        std::unordered_map<const ASTNode*, const ASTNode*> copies;
+        std::vector<std::pair<const ASTNode*, bool>> stack{ { root, false } };
+        while (!stack.empty()) {
+            auto [n, expanded] = stack.back();
+            stack.pop_back();
+            const ASTNode* kids[3];
+            int count = astChildren(n, kids);
+            if (count == 0) {
+                copies[n] = n;
+                continue;
+            }
+            if (!expanded) {
+                stack.push_back({ n, true });
+                for (int i = 0; i < count; i++) {
+                    stack.push_back({ kids[i], false });
+                }
+                continue;
+            }
+            for (int i = 0; i < count; i++) {
+                kids[i] = copies[kids[i]];
+            }
+            const ASTNode* copy;
+            switch (n->type) {
+            case NodeType::BINARY_OP:
+                copy = fresh.make<BinaryOpNode>(static_cast<const BinaryOpNode*>(n)->op, kids[0], kids[1]);
+                break;
+            case NodeType::LET:
+                copy = fresh.make<LetNode>(kids[0], kids[1], kids[2]);
+                break;
+            default:
+                copy = fresh.make<CondNode>(kids[0], kids[1], kids[2]);
+                break;
+            }
+            copies[n] = copy;
+            auto it = infos.find(n);
+            NodeInfo moved = std::move(it->second);
+            infos.erase(it);
+            infos.emplace(copy, std::move(moved));
+        }
+        root = copies[root];
+        arena = std::move(fresh);
+        compactThreshold = std::max(arena.capacity() * 2, MIN_COMPACT_BYTES);
+    }
+
+    static Value apply(char op, const Value& l, const Value& r) {
+        switch (op) {
+        case '+': return Backend::add(l, r);
+        case '-': return Backend::sub(l, r);
+        case '*': return Backend::mul(l, r);
+        case '^': return Backend::pow(l, r);
+        case '%': return Backend::mod(l, r);
+        default:
+            throw std::runtime_error("Unknown operator");
+        }
+    }
+
+public:
+    // Parses source, which must be exactly one expression. maxDepth bounds
+    // nesting as in the Parser (0 = no limit).
+    explicit BasicIncrementalProgram(std::string_view source, size_t depthLimit = Parser::DEFAULT_MAX_DEPTH)
+        : maxDepth(depthLimit) {
+        root = parseSpan(source, 0);
+        describe(root);
+        lastReparsed = source.size();
+        compactThreshold = std::max(arena.capacity() * 2, MIN_COMPACT_BYTES);
+    }
+
+    BasicIncrementalProgram(const BasicIncrementalProgram&) = delete;
+    BasicIncrementalProgram& operator=(const BasicIncrementalProgram&) = delete;
+
+    // Current program text
+    std::string source() const {
+        return text(root);
+    }
+
+    size_t size() const { return info(root).length; }
+
+    size_t nodeCount() const { return info(root).nodes; }
+
+    // The index-th node in pre-order (0 is the root)
+    Subtree subtree(size_t index) const {
+        if (index >= nodeCount()) {
+            throw std::out_of_range("Subtree index out of range");
+        }
+        const ASTNode* node = root;
+        size_t offset = 0;
+        while (index != 0) {
+            index--;
+            const ASTNode* kids[3];
+            int count = astChildren(node, kids);
+            offset += 2;
+            for (int i = 0; i < count; i++) {
+                const NodeInfo& c = info(kids[i]);
+                if (index < c.nodes) {
+                    node = kids[i];
+                    break;
+                }
+                index -= c.nodes;
+                offset += c.length;
+            }
+        }
+        return { offset, info(node).length };
+    }
+
+    // Replaces source bytes [offset, offset + length) with text. The smallest
+    // enclosing subtree is re-parsed, widening to its parent while the result
+    // does not parse; if the whole program would not parse the error is
+    // thrown and the program is left unchanged.
+    void replace(size_t offset, size_t length, std::string_view text) {
+        size_t total = size();
+        if (offset > total || length > total - offset) {
+            throw std::out_of_range("Edit outside the program");
+        }
+
+        std::vector<Step> path = locate(offset, length);
+        for (size_t k = path.size(); k-- > 0;) {
+            const Step& target = path[k];
+            std::string old = BasicIncrementalProgram::text(target.node);
+            std::string edited = old.substr(0, offset - target.offset);
+            edited += text;
+            edited += old.substr(offset + length - target.offset);
+
+            const ASTNode* node;
+            try {
+                node = parseSpan(edited, k);
+            }
+            catch (const std::runtime_error&) {
+                if (k == 0) {
+                    throw;
+                }
+                continue;
+            }
+            if (k > 0 && !fits(path[k - 1].node, path[k - 1].childIndex, node)) {
+                continue;
+            }
+
+            // Splice the new subtree in and path-copy the ancestors
+            describe(node);
+            forget(target.node);
+            for (size_t j = k; j-- > 0;) {
+                const ASTNode* parent = withChild(path[j].node, path[j].childIndex, node);
+                infos.erase(path[j].node);
+                describe(parent);
+                node = parent;
+            }
+            root = node;
+            lastReparsed = edited.size();
+            compactIfNeeded();
+            return;
+        }
+    }
+
+    // Replaces a whole subtree (from subtree()) with the expression text
+    void replace(const Subtree& target, std::string_view text) {
+        replace(target.offset, target.length, text);
+    }
+
+    // Value of the program. Only nodes created since the last call are
+    // evaluated; everything else comes from the side table. Errors are
+    // remembered the same way and rethrown.
+    Value evaluate() {
+        lastEvaluated = 0;
+        std::vector<std::pair<const ASTNode*, int>> stack{ { root, 0 } };
+
+        while (!stack.empty()) {
+            auto& [node, stage] = stack.back();
+            NodeInfo& ni = infos.find(node)->second;
+            if (ni.known) {
+                stack.pop_back();
+                continue;
+            }
+
+            // Operands in evaluation order: a let's value before its name,
+            // a conditional's condition and then one branch
+            const ASTNode* kids[3];
+            int count = astChildren(node, kids);
+            if (node->type == NodeType::LET) {
+                std::swap(kids[0], kids[1]);
+            }
+            if (node->type == NodeType::COND) {
+                count = stage == 0 ? 1 : 2;
+                if (stage > 0) {
+                    kids[1] = Backend::isZero(info(kids[0]).value) ? kids[2] : kids[1];
+                }
+            }
+
+            if (stage < count) {
+                const NodeInfo& c = info(kids[stage]);
+                if (!c.known) {
+                    stack.push_back({ kids[stage], 0 });
+                    continue;
+                }
+                if (c.failed) {
+                    ni.known = true;
+                    ni.failed = true;
+                    ni.error = c.error;
+                    lastEvaluated++;
+                    stack.pop_back();
+                    continue;
+                }
+                stage++;
+                continue;
+            }
+
+            lastEvaluated++;
+            ni.known = true;
+            try {
+                switch (node->type) {
+                case NodeType::VALUE:
+                    ni.value = Backend::unit();
+                    break;
+                case NodeType::BINARY_OP:
+                    ni.value = apply(static_cast<const BinaryOpNode*>(node)->op, info(kids[0]).value, info(kids[1]).value);
+                    break;
+                case NodeType::LET:
+                    ni.value = info(kids[2]).value;
+                    break;
+                default:
+                    ni.value = info(kids[1]).value;
+                    break;
+                }
+            }
+            catch (const std::runtime_error& e) {
+                ni.failed = true;
+                ni.error = e.what();
+            }
+            stack.pop_back();
+        }
+
+        const NodeInfo& result = info(root);
+        if (result.failed) {
+            throw std::runtime_error(result.error);
+        }
+        return result.value;
+    }
+
+    // Source bytes parsed by the last edit (or the constructor)
+    size_t reparsedBytes() const { return lastReparsed; }
+
+    // Nodes computed by the last evaluate() call
+    size_t evaluatedNodes() const { return lastEvaluated; }
+};
+
+using IncrementalProgram = BasicIncrementalProgram<Int32Backend>;
+
+// ============================================================================
+// Work-Stealing Thread Pool
+// ============================================================================
+
+// Fixed set of workers, each with its own task deque. A worker runs its own
+// tasks newest-first and, when it runs dry, steals the oldest task of another
+// worker, so uneven task sizes do not leave threads idle.
+class WorkStealingPool {
+public:
+    // The argument is the index of the worker running the task
+    using Task = std::function<void(size_t)>;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    std::atomic<size_t> queued{ 0 };  // submitted, not yet picked up
+    std::atomic<size_t> pending{ 0 }; // submitted, not yet finished
+    std::atomic<size_t> nextQueue{ 0 };
+    bool stopping = false;
+
+    bool popLocal(size_t w, Task& task) {
+        Queue& q = *queues[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) {
+            return false;
+        }
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t w, Task& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue& q = *queues[(w + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t w) {
+        for (;;) {
+            Task task;
+            if (popLocal(w, task) || steal(w, task)) {
+                queued--;
+                task(w);
+                if (--pending == 0) {
+                    std::lock_guard<std::mutex> lock(stateMutex);
+                    allDone.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(stateMutex);
+            workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t threads) {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Queues a task, spreading submissions round-robin over the workers
+    void submit(Task task) {
+        Queue& q = *queues[nextQueue++ % queues.size()];
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(std::move(task));
+        }
+        queued++;
+        std::lock_guard<std::mutex> lock(stateMutex);
+        workAvailable.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+};
+
+// ============================================================================
+// Parallel Evaluation
+// ============================================================================
+
+// Operand weight (ASTNode::weight) below which subtrees are never forked
+inline constexpr uint16_t PARALLEL_DEFAULT_GRAIN = 4096;
+
+// Tree evaluator that forks large independent subtrees onto a
+// WorkStealingPool. At a binary node whose operands both weigh at least the
+// grain, the right operand is queued as a task and the left one evaluated
+// here; everything smaller is evaluated inline as by BasicEvaluator. Operands
+// are pure and environments immutable, so the value is that of a sequential
+// run, and so is the error: a failing left operand wins over its right
+// sibling, which is then cancelled.
+//
+// A join never runs unrelated tasks while it waits. A fork no worker has
+// picked up yet is taken back and evaluated in place, and one already
+// running is waited for. Each thread thus runs one evaluation at a time,
+// nothing recurses on the native stack, and a thread only ever waits on a
+// task inside its own subtree, so joins cannot deadlock. There are no step
+// or time limits and no memoization; GlyphInterpreter uses BasicEvaluator
+// for those.
+template <typename Backend>
+class BasicParallelEvaluator {
+public:
+    using Value = typename Backend::Value;
+    using Env = BasicEnvironment<Value>;
+
+private:
+    struct Task {
+        const ASTNode* node;
+        int stage;
+    };
+
+    // Stage of a binary node whose right operand was forked: join it
+    static constexpr int JOIN = 3;
+
+    // Node evaluations between checks of a fork's cancellation flag
+    static constexpr uint32_t CANCEL_INTERVAL = 1024;
+
+    enum class ForkState { QUEUED, RUNNING, DONE, TAKEN_BACK };
+
+    // A forked operand, shared by the evaluator that forked it and the task
+    // that may run it
+    struct Fork {
+        const ASTNode* node;
+        const Env* env;
+        std::mutex mutex;
+        std::condition_variable finished;
+        ForkState state = ForkState::QUEUED;
+        std::atomic<bool> cancelled{ false };
+        Value value;
+        std::exception_ptr error;
+    };
+
+    // Unwinds a cancelled fork, whose outcome nobody reads
+    struct Cancelled {};
+
+    WorkStealingPool* pool;
+    uint16_t grain;
+    std::vector<Task> tasks;
+    std::vector<Value> values;
+    std::deque<Env> frames;
+    std::vector<std::shared_ptr<Fork>> forks; // not yet joined, innermost last
+
+    Value pop() {
+        Value v = std::move(values.back());
+        values.pop_back();
+        return v;
+    }
+
+    // Runs a fork on a pool worker with that thread's evaluator, unless the
+    // forking evaluator took it back first
+    static void runFork(const std::shared_ptr<Fork>& fork, WorkStealingPool* pool, uint16_t grain) {
+        {
+            std::lock_guard<std::mutex> lock(fork->mutex);
+            if (fork->state != ForkState::QUEUED) {
+                return;
+            }
+            fork->state = ForkState::RUNNING;
+        }
+
+        static thread_local BasicParallelEvaluator worker;
+        worker.pool = pool;
+        worker.grain = grain;
+        try {
+            fork->value = worker.run(*fork->node, *fork->env, &fork->cancelled);
+        }
+        catch (...) {
+            fork->error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(fork->mutex);
+        fork->state = ForkState::DONE;
+        fork->finished.notify_all();
+    }
+
+    void fork(const ASTNode* node, const Env& env) {
+        auto f = std::make_shared<Fork>();
+        f->node = node;
+        f->env = &env;
+        forks.push_back(f);
+        WorkStealingPool* p = pool;
+        uint16_t g = grain;
+        pool->submit([f, p, g](size_t) { runFork(f, p, g); });
+    }
+
+    // Joins the innermost fork and pushes its value (or rethrows its error).
+    // Returns false instead if no worker had started it, in which case it is
+    // the caller's to evaluate.
+    bool join() {
+        std::shared_ptr<Fork> f = std::move(forks.back());
+        forks.pop_back();
+        std::unique_lock<std::mutex> lock(f->mutex);
+        if (f->state == ForkState::QUEUED) {
+            f->state = ForkState::TAKEN_BACK;
+            return false;
+        }
+        f->finished.wait(lock, [&] { return f->state == ForkState::DONE; });
+        if (f->error) {
+            // Moved out so the worker's last reference does not free it
+            std::exception_ptr error = std::move(f->error);
+            lock.unlock();
+            std::rethrow_exception(error);
+        }
+        values.push_back(std::move(f->value));
+        return true;
+    }
+
+    // On failure: the outstanding forks' results no longer matter, but they
+    // read frames of this evaluator, so none may still be running when it
+    // returns
+    void abandon() {
+        for (auto& f : forks) {
+            std::lock_guard<std::mutex> lock(f->mutex);
+            if (f->state == ForkState::QUEUED) {
+                f->state = ForkState::TAKEN_BACK;
+            }
+            f->cancelled = true;
+        }
+        for (auto& f : forks) {
+            std::unique_lock<std::mutex> lock(f->mutex);
+            f->finished.wait(lock, [&] { return f->state != ForkState::RUNNING; });
+        }
+        forks.clear();
+    }
+
+    template <NodeKind Kind>
+    void binary(const ASTNode* node, int stage, const Env& env) {
+        const auto* bin = static_cast<const BinaryOpNode*>(node);
+        if (stage == 0 && pool != nullptr && bin->left->weight >= grain && bin->right->weight >= grain) {
+            fork(bin->right, env);
+            tasks.back().stage = JOIN;
+            tasks.push_back({ bin->left, 0 });
+            return;
+        }
+        if (stage == JOIN) {
+            if (!join()) {
+                tasks.back().stage = 2;
+                tasks.push_back({ bin->right, 0 });
+                return;
+            }
+            stage = 2;
+        }
+        if (stage < 2) {
+            tasks.push_back({ stage == 0 ? bin->left : bin->right, 0 });
+            return;
+        }
+        Value rightVal = pop();
+        Value& leftVal = values.back();
+        leftVal = BasicEvaluator<Backend>::template apply<Kind>(leftVal, rightVal);
+        tasks.pop_back();
+    }
+
+    Value loop(const ASTNode& root, const Env& env, const std::atomic<bool>* cancel) {
+        const Env* current = &env;
+        uint32_t untilCheck = CANCEL_INTERVAL;
+        tasks.push_back({ &root, 0 });
+
+        while (!tasks.empty()) {
+            if (cancel != nullptr && --untilCheck == 0) {
+                untilCheck = CANCEL_INTERVAL;
+                if (cancel->load(std::memory_order_relaxed)) {
+                    throw Cancelled();
+                }
+            }
+            size_t top = tasks.size() - 1;
+            const ASTNode* node = tasks[top].node;
+            int stage = tasks[top].stage++;
+
+            switch (node->kind) {
+            case NodeKind::UNIT:
+                values.push_back(Backend::unit());
+                tasks.pop_back();
+                break;
+
+            case NodeKind::CONST:
+                values.push_back(Backend::fromInt(static_cast<const ConstNode*>(node)->value));
+                tasks.pop_back();
+                break;
+
+            case NodeKind::VAR: {
+                int varIndex = static_cast<const VarNode*>(node)->varIndex;
+                const Value* value = current->lookup(Backend::fromInt(varIndex));
+                if (value == nullptr) {
+                    throw std::runtime_error("Unbound variable: " + std::to_string(varIndex));
+                }
+                values.push_back(*value);
+                tasks.pop_back();
+                break;
+            }
+
+            case NodeKind::ADD:
+                binary<NodeKind::ADD>(node, stage, *current);
+                break;
+            case NodeKind::SUB:
+                binary<NodeKind::SUB>(node, stage, *current);
+                break;
+            case NodeKind::MUL:
+                binary<NodeKind::MUL>(node, stage, *current);
+                break;
+            case NodeKind::POW:
+                binary<NodeKind::POW>(node, stage, *current);
+                break;
+            case NodeKind::MOD:
+                binary<NodeKind::MOD>(node, stage, *current);
+                break;
+            case NodeKind::OTHER_OP:
+                binary<NodeKind::OTHER_OP>(node, stage, *current);
+                break;
+
+            case NodeKind::LET: {
+                const auto* let = static_cast<const LetNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ let->value, 0 });
+                }
+                else if (stage == 1) {
+                    tasks.push_back({ let->name, 0 });
+                }
+                else if (stage == 2) {
+                    Value varIndex = pop();
+                    Value val = pop();
+                    frames.emplace_back(*current, std::move(varIndex), std::move(val));
+                    current = &frames.back();
+                    tasks.push_back({ let->body, 0 });
+                }
+                else {
+                    frames.pop_back();
+                    current = frames.empty() ? &env : &frames.back();
+                    tasks.pop_back();
+                }
+                break;
+            }
+
+            case NodeKind::COND: {
+                const auto* cond = static_cast<const CondNode*>(node);
+                if (stage == 0) {
+                    tasks.push_back({ cond->condition, 0 });
+                }
+                else if (stage == 1) {
+                    Value condVal = pop();
+                    tasks.push_back({ Backend::isZero(condVal) ? cond->elseBranch : cond->thenBranch, 0 });
+                }
+                else {
+                    tasks.pop_back();
+                }
+                break;
+            }
+            }
+        }
+
+        return std::move(values.back());
+    }
+
+    Value run(const ASTNode& root, const Env& env, const std::atomic<bool>* cancel) {
+        tasks.clear();
+        values.clear();
+        frames.clear();
+        try {
+            return loop(root, env, cancel);
+        }
+        catch (...) {
+            abandon();
+            throw;
+        }
+    }
+
+public:
+    // Without a pool every subtree is evaluated inline
+    explicit BasicParallelEvaluator(WorkStealingPool* workers = nullptr, uint16_t forkGrain = PARALLEL_DEFAULT_GRAIN)
+        : pool(workers), grain(std::max<uint16_t>(forkGrain, 1)) {}
+
+    Value evaluate(const ASTNode& root, const Env& env) {
+        return run(root, env, nullptr);
+    }
+};
+
+// ============================================================================
+// Interpreter
+// ============================================================================
+
+// One interpreter may be shared by any number of threads: all mutable scratch
+// state lives in a per-thread Workspace, so every thread reuses its own VM,
+// arena and optimizer tables across calls. Configure the interpreter (the
+// set* methods) before sharing it.
+class GlyphInterpreter {
+public:
+    // Executions of one compiled program before it is promoted to native code
+    static constexpr uint32_t DEFAULT_JIT_THRESHOLD = 1000;
+
+private:
+    struct Workspace {
+        VirtualMachine vm;
+        Arena scratch; // AST storage for compile(source), recycled on every call
+        Lexer lexer{ std::string_view() };
+        Parser parser{ lexer, scratch };
+        Optimizer optimizer;
+        Compiler compiler;
+        Bytecode once; // run()'s program, executed once and then overwritten
+        BasicPackedEvaluator<Int32Backend> packed;
+        std::vector<int> nativeStack;
+        LaneEvaluator lanes;
+        StreamEvaluator stream;
+        CostAnalyzer costs;
+    };
+
+    size_t maxDepth = Parser::DEFAULT_MAX_DEPTH;
+    bool optimizeEnabled = true;
+    bool resultCacheEnabled = false;
+    bool memoizeEnabled = false;
+    ProgramCache cache;
+    std::atomic<uint64_t> memoEvaluations{ 0 };
+    std::atomic<uint64_t> memoNodes{ 0 };
+    ExecutionLimits limits;
+    uint32_t jitThreshold = DEFAULT_JIT_THRESHOLD;
+    bool statsEnabled = false;
+    mutable std::mutex statsMutex;
+    RunStats statsTotal;
+    std::unique_ptr<WorkStealingPool> forkPool;
+    uint16_t forkGrain = PARALLEL_DEFAULT_GRAIN;
+
+    // Whether the tree evaluator should fork subtrees for this program
+    bool forking() const {
+        return forkPool != nullptr && !memoizeEnabled && limits.unlimited();
+    }
+
+    static Workspace& workspace() {
+        static thread_local Workspace ws;
+        return ws;
+    }
+
+    // Parses (and optimizes) into this thread's scratch arena; the AST is
+    // valid until the thread's next call
+    const ASTNode* parseScratch(std::string_view source) {
+        return parseScratch(source, optimizeEnabled);
+    }
+
+    const ASTNode* parseScratch(std::string_view source, bool optimize) {
+        SourceScan scan = validate(source);
+
+        Workspace& ws = workspace();
+        ws.scratch.reset();
+        ws.lexer = Lexer(source);
+        ws.parser.setMaxDepth(maxDepth);
+        ws.parser.reserve(scan.maxDepth);
+        const ASTNode* ast = ws.parser.parseExpression();
+        return optimize ? ws.optimizer.optimize(ast, ws.scratch) : ast;
+    }
+
+    // Validate input - only allowed characters
+    static SourceScan validate(std::string_view source) {
+        SourceScan scan = scanSource(source);
+        if (scan.invalidOffset != std::string_view::npos) {
+            throw std::runtime_error(std::string("Invalid character: ") + source[scan.invalidOffset]);
+        }
+        return scan;
+    }
+
+    static double nanosecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // One program's counters, merged into statsTotal when it goes out of
+    // scope (also when the program fails)
+    struct StatsScope {
+        GlyphInterpreter& owner;
+        RunStats run;
+
+        ~StatsScope() {
+            std::lock_guard<std::mutex> lock(owner.statsMutex);
+            owner.statsTotal.merge(run);
+        }
+    };
+
+    template <typename Evaluator>
+    void finishEvaluation(RunStats& run, const Evaluator& evaluator, std::chrono::steady_clock::time_point start) {
+        run.evaluateNs = nanosecondsSince(start);
+        const RunStats& counted = evaluator.stats();
+        std::copy(std::begin(counted.evaluatedNodes), std::end(counted.evaluatedNodes), run.evaluatedNodes);
+        std::copy(std::begin(counted.operatorEvaluations), std::end(counted.operatorEvaluations), run.operatorEvaluations);
+        run.maxEvalDepth = counted.maxEvalDepth;
+        run.binds = counted.binds;
+        run.bindBytes = counted.bindBytes;
+        if (memoizeEnabled) {
+            memoEvaluations += evaluator.memoizedEvaluations();
+            memoNodes += evaluator.memoizedNodes();
+        }
+    }
+
+    // runWith with every phase timed and the instrumented evaluator. The
+    // program cache is bypassed so each phase really runs.
+    template <typename Backend>
+    typename Backend::Value runInstrumented(std::string_view source) {
+        StatsScope scope{ *this, RunStats() };
+        RunStats& run = scope.run;
+        run.programs = 1;
+        run.failures = 1; // until the result is in
+
+        auto start = std::chrono::steady_clock::now();
+        SourceScan scan = validate(source);
+        run.validateNs = nanosecondsSince(start);
+        run.maxNesting = scan.maxDepth;
+
+        Workspace& ws = workspace();
+        ws.scratch.reset();
+        start = std::chrono::steady_clock::now();
+        Lexer lexer(source);
+        Parser parser(lexer, ws.scratch, maxDepth);
+        parser.reserve(scan.maxDepth);
+        const ASTNode* ast = parser.parseExpression();
+        run.parseNs = nanosecondsSince(start);
+        countNodes(*ast, run.parsedNodes);
+
+        if (optimizeEnabled) {
+            start = std::chrono::steady_clock::now();
+            ast = ws.optimizer.optimize(ast, ws.scratch);
+            run.optimizeNs = nanosecondsSince(start);
+        }
+
+        BasicEvaluator<Backend, true> evaluator;
+        evaluator.setMemoize(memoizeEnabled);
+        evaluator.setLimits(limits);
+        typename Backend::Value result;
+        start = std::chrono::steady_clock::now();
+        try {
+            result = evaluator.evaluate(*ast, typename BasicEvaluator<Backend, true>::Env());
+        }
+        catch (...) {
+            finishEvaluation(run, evaluator, start);
+            throw;
+        }
+        finishEvaluation(run, evaluator, start);
+        run.failures = 0;
+        return result;
+    }
+
+    // runAs through the program cache: int32 programs are cached as
+    // bytecode, the other backends share one packed form
+    std::string runCached(std::string_view source, NumericBackend backend) {
+        uint64_t hash = hashSource(source);
+        ProgramCache::Record hit = cache.lookup(hash, source, backend, resultCacheEnabled);
+        if (hit.failed || hit.resultFailed) {
+            throw std::runtime_error(hit.text);
+        }
+        if (hit.hasResult) {
+            return hit.text;
+        }
+
+        // Everything learned below goes back in one store
+        ProgramCache::Record learned;
+        try {
+            if (backend == NumericBackend::INT32 && !hit.bytecode) {
+                hit.bytecode = learned.bytecode = std::make_shared<const Bytecode>(compile(source));
+            }
+            else if (backend != NumericBackend::INT32 && !hit.packed) {
+                hit.packed = learned.packed = std::make_shared<const PackedAST>(parsePacked(source));
+            }
+        }
+        catch (const std::runtime_error& e) {
+            learned.failed = true;
+            learned.text = e.what();
+            cache.store(hash, source, backend, learned);
+            throw;
+        }
+
+        try {
+            switch (backend) {
+            case NumericBackend::INT64:
+                learned.text = Int64Backend::toString(executeWith<Int64Backend>(*hit.packed));
+                break;
+            case NumericBackend::CHECKED_INT64:
+                learned.text = CheckedInt64Backend::toString(executeWith<CheckedInt64Backend>(*hit.packed));
+                break;
+            case NumericBackend::BIGINT:
+                learned.text = BigIntBackend::toString(executeWith<BigIntBackend>(*hit.packed));
+                break;
+            case NumericBackend::INT32:
+            default:
+                learned.text = std::to_string(execute(*hit.bytecode));
+                break;
+            }
+        }
+        catch (const std::runtime_error& e) {
+            // Running out of steps or time depends on the limits in force,
+            // not only on the program, so that outcome is not remembered
+            bool outOfBudget = dynamic_cast<const StepLimitExceeded*>(&e) != nullptr
+                || dynamic_cast<const DeadlineExceeded*>(&e) != nullptr;
+            learned.hasResult = resultCacheEnabled && !outOfBudget;
+            learned.resultFailed = true;
+            learned.text = e.what();
+            if (learned.hasResult || learned.bytecode || learned.packed) {
+                cache.store(hash, source, backend, learned);
+            }
+            throw;
+        }
+        learned.hasResult = resultCacheEnabled;
+        if (learned.hasResult || learned.bytecode || learned.packed) {
+            cache.store(hash, source, backend, learned);
+        }
+        return learned.text;
+    }
+
+public:
+    // Maximum expression nesting accepted by the parser (0 = no limit)
+    void setMaxDepth(size_t depth) {
+        maxDepth = depth;
+    }
+
+    // Constant folding and subtree sharing between parsing and evaluation
+    // (on by default). parse() always returns the unoptimized tree.
+    void setOptimize(bool enabled) {
+        optimizeEnabled = enabled;
+    }
+
+    // Cache compiled programs by source within a memory budget in bytes
+    // (0 = off, the default). Applies to run and runAs.
+    void setCacheBudget(size_t bytes) {
+        cache.setBudget(bytes);
+    }
+
+    // With the cache on, also remember each program's result or error per
+    // backend, so a repeated program is a single lookup
+    void setResultCache(bool enabled) {
+        resultCacheEnabled = enabled;
+    }
+
+    ProgramCache::Stats cacheStats() const {
+        return cache.stats();
+    }
+
+    // Maximum evaluation steps per program (0 = no limit, the default): node
+    // stages in the tree evaluator (three for an operator), instructions in
+    // the VM and packed evaluator, plus extra steps for wide BigInt
+    // operations. Exceeding it
+    // throws StepLimitExceeded.
+    void setStepLimit(uint64_t steps) {
+        limits.maxSteps = steps;
+    }
+
+    // Wall-clock limit on each program's evaluation (0 = none). Checked every
+    // few thousand steps; exceeding it throws DeadlineExceeded.
+    void setTimeout(std::chrono::nanoseconds timeout) {
+        limits.timeout = timeout;
+    }
+
+    struct MemoStats {
+        uint64_t evaluations; // shared subtrees answered from the memo
+        uint64_t nodes;       // estimated node evaluations that saved
+    };
+
+    // Memoize shared subtrees in the tree evaluator (off by default). This
+    // sends int32 programs through the tree evaluator as well; with the
+    // program cache on, runAs uses the cache instead.
+    void setMemoize(bool enabled) {
+        memoizeEnabled = enabled;
+    }
+
+    MemoStats memoStats() const {
+        return { memoEvaluations.load(), memoNodes.load() };
+    }
+
+    // Evaluate single large programs on this many extra worker threads (0 =
+    // off, the default), forking binary nodes whose operands both have at
+    // least grain nodes (see BasicParallelEvaluator). This sends int32
+    // programs through the tree evaluator as well. It is bypassed while
+    // memoization, stats or a step or time limit is on; with the program
+    // cache on, runAs uses the cache instead.
+    void setParallel(size_t threads, uint16_t grain = PARALLEL_DEFAULT_GRAIN) {
+        forkPool = threads != 0 ? std::make_unique<WorkStealingPool>(threads) : nullptr;
+        forkGrain = grain;
+    }
+
+    // Time each phase and count nodes, operators and binds (off by default).
+    // Programs then run on the instrumented tree evaluator, bypassing the
+    // program cache; with stats off none of the counting code runs.
+    void setStats(bool enabled) {
+        statsEnabled = enabled;
+    }
+
+    // Counters summed over every program run with stats on
+    RunStats stats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return statsTotal;
+    }
+
+    void resetStats() {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        statsTotal = RunStats();
+    }
+
+    // Forget cached programs and all counters. Settings are kept, and so are
+    // the per-thread buffers already sized by earlier runs.
+    void reset() {
+        cache.clear();
+        memoEvaluations = 0;
+        memoNodes = 0;
+        resetStats();
+    }
+
+    // Optimize a parsed program in place; new nodes go to its own arena
+    void optimize(ParsedProgram& program) {
+        program.root = workspace().optimizer.optimize(program.root, program.arena);
+    }
+
+    // Validate and parse a program, keeping its AST alive in the result
+    ParsedProgram parse(std::string_view source) {
+        SourceScan scan = validate(source);
+
+        ParsedProgram program;
+        Lexer lexer(source);
+        Parser parser(lexer, program.arena, maxDepth);
+        parser.reserve(scan.maxDepth);
+        program.root = parser.parseExpression();
+        return program;
+    }
+
+    // Validate and parse straight into the packed post-order encoding. No
+    // AST is built, so the optimizer does not run.
+    PackedAST parsePacked(std::string_view source) {
+        SourceScan scan = validate(source);
+
+        PackedAST program;
+        program.code.reserve(source.size());
+        Lexer lexer(source);
+        PackedParser parser(lexer, program, maxDepth);
+        parser.reserve(scan.maxDepth);
+        parser.parseExpression();
+        return program;
+    }
+
+    int execute(const PackedAST& program) {
+        Workspace& ws = workspace();
+        ws.packed.setLimits(limits);
+        return ws.packed.evaluate(program);
+    }
+
+    // Evaluate a packed program with a numeric backend chosen at compile time
+    template <typename Backend>
+    typename Backend::Value executeWith(const PackedAST& program) {
+        BasicPackedEvaluator<Backend> evaluator;
+        evaluator.setLimits(limits);
+        return evaluator.evaluate(program);
+    }
+
+    Bytecode compile(const ParsedProgram& program) {
+        Compiler compiler;
+        Bytecode result = compiler.compile(*program.root);
+        result.native = std::make_shared<NativeTier>();
+        return result;
+    }
+
+    // Validate, parse and lower a program once; the result can be executed
+    // any number of times. The intermediate AST is discarded.
+    Bytecode compile(std::string_view source) {
+        const ASTNode* ast = parseScratch(source);
+
+        Compiler compiler;
+        Bytecode result = compiler.compile(*ast);
+        result.native = std::make_shared<NativeTier>();
+        return result;
+    }
+
+    // Compiled programs executed this many times are translated to machine
+    // code and run natively from then on (0 = never). Only where
+    // NativeProgram::SUPPORTED, and only while no step or time limit is set.
+    void setJitThreshold(uint32_t executions) {
+        jitThreshold = executions;
+    }
+
+    int execute(const Bytecode& program) {
+        Workspace& ws = workspace();
+        if (program.native && jitThreshold != 0 && limits.unlimited()) {
+            const NativeProgram* native = program.native->promote(program, jitThreshold);
+            if (native != nullptr) {
+                if (ws.nativeStack.size() <= static_cast<size_t>(program.maxStackDepth)) {
+                    ws.nativeStack.resize(program.maxStackDepth + 1);
+                }
+                int result;
+                if (native->run(ws.nativeStack.data(), result)) {
+                    return result;
+                }
+                // Failed: the VM below raises the same error with its message
+            }
+        }
+        ws.vm.setLimits(limits);
+        return ws.vm.execute(program);
+    }
+
+    // Execute a program that is not owned by a Bytecode, such as a loaded
+    // BytecodeFile; such programs are never promoted to native code
+    int execute(const BytecodeView& program) {
+        Workspace& ws = workspace();
+        ws.vm.setLimits(limits);
+        return ws.vm.execute(program);
+    }
+
+    // Evaluate a tree once per lane, binding the input columns' names to that
+    // lane's values (see LaneEvaluator); int32 only
+    LaneEvaluator::Results evaluateLanes(const ASTNode& root, size_t lanes,
+        const std::vector<LaneEvaluator::Column>& inputs) {
+        return workspace().lanes.evaluate(root, lanes, inputs);
+    }
+
+    // Evaluate a program read from a std::istream in a single pass, in memory
+    // proportional to its nesting (see BasicStreamEvaluator). Not cached,
+    // optimized or counted by --stats.
+    template <typename Stream, typename = std::enable_if_t<std::is_base_of<std::istream, Stream>::value>>
+    int run(Stream& in) {
+        StreamEvaluator evaluator(maxDepth);
+        evaluator.setLimits(limits);
+        return evaluator.run(in);
+    }
+
+    template <typename Stream, typename = std::enable_if_t<std::is_base_of<std::istream, Stream>::value>>
+    std::string runAs(Stream& in, NumericBackend backend) {
+        switch (backend) {
+        case NumericBackend::INT64:
+            return Int64Backend::toString(runStream<Int64Backend>(in));
+        case NumericBackend::CHECKED_INT64:
+            return CheckedInt64Backend::toString(runStream<CheckedInt64Backend>(in));
+        case NumericBackend::BIGINT:
+            return BigIntBackend::toString(runStream<BigIntBackend>(in));
+        case NumericBackend::INT32:
+        default:
+            return std::to_string(run(in));
+        }
+    }
+
+    template <typename Backend, typename Stream>
+    typename Backend::Value runStream(Stream& in) {
+        BasicStreamEvaluator<Backend> evaluator(maxDepth);
+        evaluator.setLimits(limits);
+        return evaluator.run(in);
+    }
+
+    int run(std::string_view source) {
+        if (statsEnabled) {
+            return runInstrumented<Int32Backend>(source);
+        }
+        if (cache.enabled()) {
+            return std::stoi(runCached(source, NumericBackend::INT32));
+        }
+        if (memoizeEnabled || forking()) {
+            return runWith<Int32Backend>(source);
+        }
+        // Compiled for one execution, so never worth promoting
+        const ASTNode* ast = parseScratch(source);
+        Workspace& ws = workspace();
+        ws.compiler.compile(*ast, ws.once);
+        return execute(ws.once);
+    }
+
+    // Bounds what running source would cost (see CostAnalyzer), without
+    // running it. The program is parsed and optimized as run would, so this
+    // throws the same errors for an invalid one. steps(backend) bounds the
+    // steps run and runAs charge with this interpreter's settings: the tree
+    // evaluator for stats and memoization (which may add two steps per
+    // shared subtree), and with the program cache the packed evaluator,
+    // which runs the program unoptimized.
+    CostEstimate estimate(std::string_view source) {
+        Workspace& ws = workspace();
+        const ASTNode* parsed = parseScratch(source, false);
+        const ASTNode* ast = optimizeEnabled ? ws.optimizer.optimize(parsed, ws.scratch) : parsed;
+        CostEstimate estimate = ws.costs.analyze(*ast);
+        auto charge = [&](NumericBackend backend, uint64_t steps, uint64_t wideWork) {
+            if (backend == NumericBackend::BIGINT) {
+                steps = steps > CostEstimate::UNBOUNDED - wideWork ? CostEstimate::UNBOUNDED : steps + wideWork;
+            }
+            estimate.charged[static_cast<size_t>(backend)] = steps;
+        };
+
+        if (statsEnabled) {
+            charge(NumericBackend::INT32, estimate.treeSteps, 0);
+        }
+        else if (cache.enabled()) {
+            CostEstimate unoptimized = ast == parsed ? estimate : ws.costs.analyze(*parsed);
+            for (NumericBackend backend : { NumericBackend::INT64, NumericBackend::CHECKED_INT64, NumericBackend::BIGINT }) {
+                charge(backend, unoptimized.packedSteps, unoptimized.wideWork);
+            }
+        }
+        else if (memoizeEnabled) {
+            uint64_t extra = 2 * static_cast<uint64_t>(ws.costs.distinctNodes());
+            uint64_t steps = estimate.treeSteps > CostEstimate::UNBOUNDED - extra ? CostEstimate::UNBOUNDED : estimate.treeSteps + extra;
+            for (NumericBackend backend : { NumericBackend::INT32, NumericBackend::INT64, NumericBackend::CHECKED_INT64, NumericBackend::BIGINT }) {
+                charge(backend, steps, estimate.wideWork);
+            }
+        }
+        return estimate;
+    }
+
+    // run() that never throws for a bad program: the value, or an error code
+    // with the byte offset it was found at, built without exceptions or
+    // strings. Meant for loops over many, mostly invalid, candidates. It
+    // evaluates in one pass with the StreamEvaluator, bypassing the program
+    // cache, memoization and statistics.
+    RunResult tryRun(std::string_view source) {
+        StreamEvaluator& stream = workspace().stream;
+        stream.setMaxDepth(maxDepth);
+        stream.setLimits(limits);
+        return stream.tryEvaluate(source);
+    }
+
+    // Evaluate with a numeric backend chosen at compile time
+    template <typename Backend>
+    typename Backend::Value runWith(std::string_view source) {
+        const ASTNode* ast = parseScratch(source);
+        if (forking()) {
+            BasicParallelEvaluator<Backend> evaluator(forkPool.get(), forkGrain);
+            return evaluator.evaluate(*ast, typename BasicParallelEvaluator<Backend>::Env());
+        }
+
+        // Reused across calls. Its memo is keyed by node address and the
+        // scratch arena hands the same addresses to the next program, so the
+        // memo is dropped first.
+        static thread_local BasicEvaluator<Backend> evaluator;
+        evaluator.clearMemo();
+        evaluator.setMemoize(memoizeEnabled);
+        evaluator.setLimits(limits);
+        size_t hits = evaluator.memoizedEvaluations();
+        size_t saved = evaluator.memoizedNodes();
+        typename Backend::Value result = evaluator.evaluate(*ast, typename BasicEvaluator<Backend>::Env());
+        if (memoizeEnabled) {
+            memoEvaluations += evaluator.memoizedEvaluations() - hits;
+            memoNodes += evaluator.memoizedNodes() - saved;
+        }
+        return result;
+    }
+
+    // Evaluate with a numeric backend chosen at run time; int32 programs take
+    // the bytecode path.
+    std::string runAs(std::string_view source, NumericBackend backend) {
+        if (statsEnabled) {
+            switch (backend) {
+            case NumericBackend::INT64:
+                return Int64Backend::toString(runInstrumented<Int64Backend>(source));
+            case NumericBackend::CHECKED_INT64:
+                return CheckedInt64Backend::toString(runInstrumented<CheckedInt64Backend>(source));
+            case NumericBackend::BIGINT:
+                return BigIntBackend::toString(runInstrumented<BigIntBackend>(source));
+            case NumericBackend::INT32:
+            default:
+                return std::to_string(runInstrumented<Int32Backend>(source));
+            }
+        }
+        if (cache.enabled()) {
+            return runCached(source, backend);
+        }
+        switch (backend) {
+        case NumericBackend::INT64:
+            return Int64Backend::toString(runWith<Int64Backend>(source));
+        case NumericBackend::CHECKED_INT64:
+            return CheckedInt64Backend::toString(runWith<CheckedInt64Backend>(source));
+        case NumericBackend::BIGINT:
+            return BigIntBackend::toString(runWith<BigIntBackend>(source));
+        case NumericBackend::INT32:
+        default:
+            return std::to_string(run(source));
+        }
+    }
+};
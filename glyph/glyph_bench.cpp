@@ -0,0 +1,1070 @@
+#include "glyph.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <istream>
+#include <new>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// glyph-bench: times each pipeline phase on synthetic workloads and prints
+// the results as JSON, so runs can be diffed between releases. The --check-*
+// modes instead verify a property of the interpreter and exit nonzero if it
+// does not hold; `make test` runs them.
+
+// ============================================================================
+// Workloads
+// ============================================================================
+
+// Source text for the number n built from _ by doubling
+static std::string numberSource(long long n) {
+    if (n == 1) {
+        return "_";
+    }
+    std::string half = "(*(+__)" + numberSource(n / 2) + ")";
+    return n % 2 == 0 ? half : "(+" + half + "_)";
+}
+
+// (+(+(+_ _)_)_) nested `depth` levels deep, evaluating to depth + 1
+static std::string deepNesting(long long depth) {
+    std::string s;
+    s.reserve(static_cast<size_t>(depth) * 4 + 1);
+    for (long long i = 0; i < depth; i++) {
+        s += "(+";
+    }
+    s += '_';
+    for (long long i = 0; i < depth; i++) {
+        s += "_)";
+    }
+    return s;
+}
+
+// A balanced tree with 2^levels leaves; alternating + and - keep it small
+static std::string wideTree(long long levels) {
+    std::string s = "_";
+    for (long long i = 0; i < levels; i++) {
+        s = (i % 2 == 0 ? "(+" : "(-") + s + s + ")";
+    }
+    return s;
+}
+
+// `count` nested lets, each binding _ to _ around the next
+static std::string letChain(long long count) {
+    std::string s;
+    s.reserve(static_cast<size_t>(count) * 5 + 1);
+    for (long long i = 0; i < count; i++) {
+        s += "(:__";
+    }
+    s += '_';
+    s.append(static_cast<size_t>(count), ')');
+    return s;
+}
+
+// A sum of `count` terms (-1)^(2^30), each a large exponent
+static std::string largeExponents(long long count) {
+    std::string term = "(^(-_(+__))(^(+__)" + numberSource(30) + "))";
+    std::string s;
+    for (long long i = 1; i < count; i++) {
+        s += "(+" + term;
+    }
+    s += term;
+    s.append(static_cast<size_t>(count - 1), ')');
+    return s;
+}
+
+// Conditionals nested `levels` deep in both branches; only one path of
+// `levels` conditions is ever taken
+static std::string heavyConditionals(long long levels) {
+    std::string s = "(^(+__)(+(+__)_))";
+    for (long long i = 0; i < levels; i++) {
+        s = std::string("(%") + (i % 2 == 0 ? "(+__)" : "(-__)") + s + s + ")";
+    }
+    return s;
+}
+
+struct Workload {
+    const char* name;
+    std::string (*generate)(long long);
+    long long defaultParam;
+};
+
+static const Workload WORKLOADS[] = {
+    { "deep-nesting", deepNesting, 200000 },
+    { "wide-tree", wideTree, 18 },
+    { "let-chain", letChain, 100000 },
+    { "large-exponents", largeExponents, 2000 },
+    { "heavy-conditionals", heavyConditionals, 17 },
+};
+
+// ============================================================================
+// Measurement
+// ============================================================================
+
+struct Timing {
+    double minNs;
+    double medianNs;
+    double meanNs;
+};
+
+// Keeps results observable so timed work cannot be optimized away
+static volatile long long sink;
+
+// Runs setup (untimed) and body warmup + reps times; only the reps count
+template <typename Setup, typename Body>
+static Timing measure(int warmup, int reps, Setup setup, Body body) {
+    std::vector<double> samples;
+    for (int i = 0; i < warmup + reps; i++) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if (i >= warmup) {
+            samples.push_back(elapsed.count());
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double s : samples) {
+        total += s;
+    }
+    return { samples.front(), samples[samples.size() / 2], total / samples.size() };
+}
+
+template <typename Body>
+static Timing measure(int warmup, int reps, Body body) {
+    return measure(warmup, reps, [] {}, body);
+}
+
+// Process-wide high-water mark of resident memory, in KiB. It never goes
+// down, so it is reported once for the whole run rather than per workload.
+static long long peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<long long>(counters.PeakWorkingSetSize / 1024);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+// ============================================================================
+// Benchmarks
+// ============================================================================
+
+struct Options {
+    int warmup = 2;
+    int reps = 10;
+    std::vector<std::pair<const Workload*, long long>> selected;
+};
+
+static void printPhase(std::FILE* out, const char* name, const Timing& t, size_t bytes, bool last) {
+    double mbPerS = t.medianNs > 0 ? bytes / t.medianNs * 1e9 / (1024.0 * 1024.0) : 0;
+    std::fprintf(out, "        \"%s\": { \"min_ns\": %.0f, \"median_ns\": %.0f, \"mean_ns\": %.0f, \"mb_per_s\": %.1f }%s\n",
+        name, t.minNs, t.medianNs, t.meanNs, mbPerS, last ? "" : ",");
+}
+
+// Times validate, lex, parse, optimize, compile and the three evaluators on
+// one program, each phase on its own
+static void runWorkload(std::FILE* out, const Options& opt, const Workload& w, long long param, bool last) {
+    std::string source = w.generate(param);
+    std::string_view src = source;
+    int warmup = opt.warmup;
+    int reps = opt.reps;
+
+    Timing validate = measure(warmup, reps, [&] {
+        sink = static_cast<long long>(scanSource(src).maxDepth);
+    });
+
+    Timing lex = measure(warmup, reps, [&] {
+        Lexer lexer(src);
+        long long operators = 0;
+        while (lexer.peek() != '\0') {
+            operators += lexer.isOperator(lexer.consume());
+        }
+        sink = operators;
+    });
+
+    Arena arena;
+    const ASTNode* tree = nullptr;
+    auto parseTree = [&] {
+        arena.reset();
+        Lexer lexer(src);
+        Parser parser(lexer, arena, 0);
+        tree = parser.parseExpression();
+    };
+    Timing parse = measure(warmup, reps, parseTree);
+    size_t astBytes = arena.capacity();
+
+    Optimizer optimizer;
+    Timing optimize = measure(warmup, reps, parseTree, [&] {
+        sink = reinterpret_cast<std::uintptr_t>(optimizer.optimize(tree, arena));
+    });
+
+    // Evaluation phases run on the unoptimized tree; optimized, every
+    // workload here would fold to a single constant.
+    parseTree();
+    std::string result;
+    Evaluator evaluator;
+    Timing evaluate = measure(warmup, reps, [&] {
+        try {
+            result = std::to_string(evaluator.evaluate(*tree, Environment()));
+        }
+        catch (const std::exception& e) {
+            result = std::string("error: ") + e.what();
+        }
+    });
+
+    Bytecode bytecode;
+    Timing compile = measure(warmup, reps, [&] {
+        Compiler compiler;
+        bytecode = compiler.compile(*tree);
+    });
+
+    VirtualMachine vm;
+    Timing execute = measure(warmup, reps, [&] {
+        try {
+            sink = vm.execute(bytecode);
+        }
+        catch (const std::exception&) {
+        }
+    });
+
+    // Empty (and both phases trivial) where NativeProgram is unsupported
+    NativeProgram native;
+    Timing jit = measure(warmup, reps, [&] {
+        native.compile(bytecode);
+    });
+
+    std::vector<int> nativeStack(bytecode.maxStackDepth + 1);
+    Timing executeNative = measure(warmup, reps, [&] {
+        int value;
+        if (native && native.run(nativeStack.data(), value)) {
+            sink = value;
+        }
+    });
+
+    PackedAST packed;
+    Timing packedParse = measure(warmup, reps, [&] {
+        Lexer lexer(src);
+        PackedParser parser(lexer, packed, 0);
+        parser.parseExpression();
+    });
+
+    BasicPackedEvaluator<Int32Backend> packedEvaluator;
+    Timing packedEvaluate = measure(warmup, reps, [&] {
+        try {
+            sink = packedEvaluator.evaluate(packed);
+        }
+        catch (const std::exception&) {
+        }
+    });
+
+    GlyphInterpreter interpreter;
+    interpreter.setMaxDepth(0);
+    Timing endToEnd = measure(warmup, reps, [&] {
+        try {
+            sink = interpreter.run(src);
+        }
+        catch (const std::exception&) {
+        }
+    });
+
+    std::fprintf(out, "    {\n");
+    std::fprintf(out, "      \"name\": \"%s\",\n", w.name);
+    std::fprintf(out, "      \"param\": %lld,\n", param);
+    std::fprintf(out, "      \"source_bytes\": %zu,\n", source.size());
+    std::fprintf(out, "      \"result\": %s,\n", jsonString(result).c_str());
+    std::fprintf(out, "      \"ast_bytes\": %zu,\n", astBytes);
+    std::fprintf(out, "      \"bytecode_bytes\": %zu,\n", bytecode.code.size() * sizeof(Instruction));
+    std::fprintf(out, "      \"packed_bytes\": %zu,\n", packed.code.size());
+    std::fprintf(out, "      \"phases\": {\n");
+    printPhase(out, "validate", validate, source.size(), false);
+    printPhase(out, "lex", lex, source.size(), false);
+    printPhase(out, "parse", parse, source.size(), false);
+    printPhase(out, "optimize", optimize, source.size(), false);
+    printPhase(out, "evaluate_tree", evaluate, source.size(), false);
+    printPhase(out, "compile", compile, source.size(), false);
+    printPhase(out, "execute_vm", execute, source.size(), false);
+    printPhase(out, "jit_compile", jit, source.size(), false);
+    printPhase(out, "execute_native", executeNative, source.size(), false);
+    printPhase(out, "parse_packed", packedParse, source.size(), false);
+    printPhase(out, "evaluate_packed", packedEvaluate, source.size(), false);
+    printPhase(out, "run", endToEnd, source.size(), true);
+    std::fprintf(out, "      }\n");
+    std::fprintf(out, "    }%s\n", last ? "" : ",");
+    std::fflush(out);
+}
+
+// The original repeated-multiplication kernel, kept as a baseline for powInt
+static int powLinear(int base, int exponent) {
+    int result = 1;
+    for (int i = 0; i < exponent; i++) {
+        result *= base;
+    }
+    return result;
+}
+
+template <typename Kernel>
+static double nsPerCall(Kernel kernel, const std::vector<std::pair<int, int>>& cases, int rounds) {
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& [base, exponent] : cases) {
+            checksum += kernel(base, exponent);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    sink = checksum;
+    return elapsed.count() / (static_cast<double>(rounds) * cases.size());
+}
+
+// Compares powInt against powLinear on operands that fit in an int
+static void runPowKernel(std::FILE* out) {
+    std::vector<std::pair<int, int>> small;
+    for (int base = -3; base <= 3; base++) {
+        for (int exponent = 0; exponent <= 19; exponent++) {
+            small.push_back({ base, exponent });
+        }
+    }
+    std::vector<std::pair<int, int>> large = { { 1, 1 << 30 }, { -1, (1 << 30) + 1 } };
+
+    std::fprintf(out, "  \"pow_kernel\": {\n");
+    std::fprintf(out, "    \"small_linear_ns\": %.2f,\n", nsPerCall(powLinear, small, 200000));
+    std::fprintf(out, "    \"small_squaring_ns\": %.2f,\n", nsPerCall(powInt, small, 200000));
+    std::fprintf(out, "    \"large_linear_ns\": %.0f,\n", nsPerCall(powLinear, large, 1));
+    std::fprintf(out, "    \"large_squaring_ns\": %.2f\n", nsPerCall(powInt, large, 1000000));
+    std::fprintf(out, "  },\n");
+}
+
+// ============================================================================
+// Allocation Check
+// ============================================================================
+
+// Every global operator new is counted, so the check sees allocations made
+// anywhere in the interpreter and the standard library
+static std::atomic<unsigned long long> allocations{ 0 };
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size != 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+// GCC cannot tell that these free() what the operator new above malloc()ed
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// Runs each workload (at a small size) through run() and runAs() for every
+// backend, with the optimizer on and off. After one warm-up pass that sizes
+// the interpreter's buffers, further passes must not allocate. Returns the
+// process exit status.
+static int checkAllocations() {
+    const std::pair<const Workload*, long long> programs[] = {
+        { &WORKLOADS[0], 2000 },
+        { &WORKLOADS[1], 10 },
+        { &WORKLOADS[2], 1000 },
+        { &WORKLOADS[4], 8 },
+    };
+    const char* const backends[] = { "int32", "int64", "checked-int64", "bigint" };
+    constexpr int PASSES = 4;
+
+    int checked = 0;
+    int failures = 0;
+    for (bool optimize : { true, false }) {
+        GlyphInterpreter interpreter;
+        interpreter.setOptimize(optimize);
+        for (const auto& [workload, param] : programs) {
+            std::string source = workload->generate(param);
+            for (const char* name : backends) {
+                NumericBackend backend = NumericBackend::INT32;
+                parseNumericBackend(name, backend);
+                unsigned long long before = 0;
+                for (int pass = 0; pass <= PASSES; pass++) {
+                    if (pass == 1) {
+                        before = allocations.load(std::memory_order_relaxed);
+                    }
+                    if (backend == NumericBackend::INT32) {
+                        sink = interpreter.run(source);
+                    }
+                    else {
+                        sink = static_cast<long long>(interpreter.runAs(source, backend).size());
+                    }
+                }
+                unsigned long long made = allocations.load(std::memory_order_relaxed) - before;
+                checked++;
+                if (made != 0) {
+                    std::fprintf(stderr, "%s, %s, optimize %s: %llu allocations in %d runs\n", workload->name,
+                        name, optimize ? "on" : "off", made, PASSES);
+                    failures++;
+                }
+            }
+        }
+    }
+    if (failures != 0) {
+        std::fprintf(stderr, "glyph-bench: %d of %d configurations allocated after warm-up\n", failures, checked);
+        return 1;
+    }
+    std::printf("allocation check: %d configurations, none allocated after warm-up\n", checked);
+    return 0;
+}
+
+// ============================================================================
+// Differential Checks
+// ============================================================================
+
+// Each check runs random programs through one evaluation path and compares
+// every outcome against GlyphInterpreter::run on the same text. Seeds are
+// fixed, so a failure reproduces.
+
+// A random program about depth levels deep, with every operator, both
+// meanings of %, lets, and values that overflow int32 or raise errors
+static std::string randomProgram(std::mt19937& rng, int depth) {
+    if (depth <= 0 || rng() % 5 == 0) {
+        return "_";
+    }
+    unsigned r = rng() % 100;
+    if (r < 55) {
+        char op = "+-*^%"[rng() % 5];
+        if (op == '%') {
+            return "(%_" + randomProgram(rng, depth - 1) + ")";
+        }
+        return std::string("(") + op + randomProgram(rng, depth - 1) + randomProgram(rng, depth - 1) + ")";
+    }
+    if (r < 80) {
+        return "(%(+" + randomProgram(rng, depth - 2) + randomProgram(rng, depth - 2) + ")"
+            + randomProgram(rng, depth - 1) + randomProgram(rng, depth - 1) + ")";
+    }
+    return "(:" + randomProgram(rng, 2) + randomProgram(rng, depth - 1) + randomProgram(rng, depth - 1) + ")";
+}
+
+// The value as text, or "error: " and the message
+static std::string outcomeOf(const std::function<std::string()>& evaluate) {
+    try {
+        return evaluate();
+    }
+    catch (const std::exception& e) {
+        return std::string("error: ") + e.what();
+    }
+}
+
+// Whether source is exactly one expression, as IncrementalProgram requires
+// (run() ignores anything after the first)
+static bool parsesExactly(const std::string& source) {
+    try {
+        Arena arena;
+        Lexer lexer(source);
+        Parser parser(lexer, arena, 0);
+        parser.parseExpression();
+        return lexer.peek() == '\0';
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Edits random programs through IncrementalProgram::replace and compares
+// each evaluate() with run() on the edited text. Edits replace a whole
+// subtree, turn a modulo into a conditional (which only parses once widened
+// to the parent), or splice a few random bytes anywhere, which often leaves
+// no valid program: those must be rejected exactly when the text no longer
+// parses, and leave the program as it was.
+static int checkIncremental() {
+    constexpr int PROGRAMS = 300;
+    constexpr int EDITS = 40;
+    std::mt19937 rng(18);
+    GlyphInterpreter reference;
+
+    long edits = 0;
+    long widened = 0;
+    long rejected = 0;
+    int failures = 0;
+    auto fail = [&](const std::string& what) {
+        if (failures++ < 10) {
+            std::fprintf(stderr, "%s\n", what.c_str());
+        }
+    };
+
+    for (int p = 0; p < PROGRAMS && failures == 0; p++) {
+        std::string expected = randomProgram(rng, 3 + rng() % 9);
+        IncrementalProgram program(expected);
+        for (int e = 0; e < EDITS; e++) {
+            size_t offset;
+            size_t length;
+            std::string text;
+            IncrementalProgram::Subtree target = program.subtree(rng() % program.nodeCount());
+            unsigned kind = rng() % 4;
+            if (kind == 0 && expected.compare(target.offset, 3, "(%_") == 0) {
+                // (%_ b) becomes (%(cond)_ b): the new text does not parse
+                // in place of the _, only as the whole %
+                offset = target.offset + 2;
+                length = 1;
+                text = "(+" + randomProgram(rng, 2) + randomProgram(rng, 2) + ")_";
+            }
+            else if (kind <= 1) {
+                offset = target.offset;
+                length = target.length;
+                text = randomProgram(rng, rng() % 4);
+            }
+            else {
+                offset = rng() % (expected.size() + 1);
+                length = rng() % std::min<size_t>(4, expected.size() - offset + 1);
+                for (int n = rng() % 2 == 0 ? 0 : 1 + rng() % 3; n > 0; n--) {
+                    text += "()+-*^%_:"[rng() % 9];
+                }
+            }
+            std::string edited = expected.substr(0, offset) + text + expected.substr(offset + length);
+
+            // The smallest subtree that encloses the edit, as replace() first
+            // tries; re-parsing more than its edited text means widening
+            size_t enclosing = expected.size();
+            for (size_t i = 0; i < program.nodeCount(); i++) {
+                IncrementalProgram::Subtree node = program.subtree(i);
+                bool inside = length != 0
+                    ? node.offset <= offset && offset + length <= node.offset + node.length
+                    : node.offset < offset && offset < node.offset + node.length;
+                if (inside && node.length < enclosing) {
+                    enclosing = node.length;
+                }
+            }
+            enclosing = enclosing - length + text.size();
+
+            bool accepted = true;
+            try {
+                program.replace(offset, length, text);
+            }
+            catch (const std::exception&) {
+                accepted = false;
+            }
+            edits++;
+            if (accepted != parsesExactly(edited)) {
+                fail("replace " + std::string(accepted ? "accepted" : "rejected") + " [" + edited + "]");
+                break;
+            }
+            if (accepted) {
+                expected = edited;
+                if (program.reparsedBytes() > enclosing) {
+                    widened++;
+                }
+            }
+            else {
+                rejected++;
+            }
+            if (program.source() != expected) {
+                fail("source [" + program.source() + "], expected [" + expected + "]");
+                break;
+            }
+
+            std::string got = outcomeOf([&] { return std::to_string(program.evaluate()); });
+            std::string want = outcomeOf([&] { return std::to_string(reference.run(expected)); });
+            if (got != want) {
+                fail(expected + ": evaluate() " + got + ", run() " + want);
+            }
+        }
+    }
+
+    if (failures == 0 && (widened == 0 || rejected == 0)) {
+        std::fprintf(stderr, "glyph-bench: no widened or no rejected edits were generated (%ld, %ld)\n", widened, rejected);
+        return 1;
+    }
+    if (failures != 0) {
+        std::fprintf(stderr, "glyph-bench: %d incremental mismatches\n", failures);
+        return 1;
+    }
+    std::printf("incremental check: %ld edits (%ld widened, %ld rejected), all match run()\n",
+        edits, widened, rejected);
+    return 0;
+}
+
+// A random tree over free variables 0..2 and lets that bind names 0..3.
+// The parser never produces variables, so it is built directly; constants
+// include 0 and the int32 extremes, so lanes divide by zero, overflow ^ and
+// read the unbound name 3.
+static const ASTNode* randomLaneTree(std::mt19937& rng, Arena& arena, int depth) {
+    static const int CONSTANTS[] = { 0, 1, -1, 2, 3, 7, 46341, INT_MAX, INT_MIN };
+    if (depth <= 0 || rng() % 6 == 0) {
+        switch (rng() % 3) {
+        case 0: return arena.make<VarNode>(static_cast<int>(rng() % 8 == 0 ? 3 : rng() % 3));
+        case 1: return ValueNode::instance();
+        default: return arena.make<ConstNode>(CONSTANTS[rng() % (sizeof(CONSTANTS) / sizeof(CONSTANTS[0]))]);
+        }
+    }
+    unsigned r = rng() % 10;
+    if (r < 6) {
+        char op = "+-*^%"[rng() % 5];
+        const ASTNode* left = randomLaneTree(rng, arena, depth - 1);
+        return arena.make<BinaryOpNode>(op, left, randomLaneTree(rng, arena, depth - 1));
+    }
+    if (r < 8) {
+        const ASTNode* cond = randomLaneTree(rng, arena, depth - 1);
+        const ASTNode* then = randomLaneTree(rng, arena, depth - 1);
+        return arena.make<CondNode>(cond, then, randomLaneTree(rng, arena, depth - 1));
+    }
+    const ASTNode* name = arena.make<ConstNode>(static_cast<int>(rng() % 4));
+    const ASTNode* value = randomLaneTree(rng, arena, depth - 1);
+    return arena.make<LetNode>(name, value, randomLaneTree(rng, arena, depth - 1));
+}
+
+// Evaluates random trees over random input columns with evaluateLanes and
+// compares every lane against the scalar Evaluator in an Environment
+// binding that lane's values. Lane counts straddle LaneEvaluator::BLOCK, and
+// conditionals on variables split the lanes between both branches.
+static int checkLanes() {
+    constexpr int TREES = 400;
+    constexpr size_t MAX_LANES = 3 * LaneEvaluator::BLOCK + 5;
+    static const int INPUTS[] = { 0, 0, 1, -1, 2, 5, -7, 65536, 46341, INT_MAX, INT_MIN };
+    std::mt19937 rng(22);
+    GlyphInterpreter interpreter;
+    Evaluator scalar;
+
+    long lanesChecked = 0;
+    long lanesFailed = 0;
+    int mixedTrees = 0; // trees with both failing and succeeding lanes
+    int failures = 0;
+    for (int t = 0; t < TREES && failures < 10; t++) {
+        Arena arena;
+        const ASTNode* root = randomLaneTree(rng, arena, 2 + rng() % 6);
+        size_t lanes = 1 + rng() % MAX_LANES;
+        std::vector<std::vector<int>> data(3, std::vector<int>(lanes));
+        std::vector<LaneEvaluator::Column> columns;
+        for (int name = 0; name < 3; name++) {
+            for (int& v : data[name]) {
+                v = INPUTS[rng() % (sizeof(INPUTS) / sizeof(INPUTS[0]))];
+            }
+            columns.push_back({ name, data[name].data() });
+        }
+
+        LaneEvaluator::Results results = interpreter.evaluateLanes(*root, lanes, columns);
+        size_t failedHere = 0;
+        for (size_t lane = 0; lane < lanes; lane++) {
+            Environment empty;
+            Environment x(empty, 0, data[0][lane]);
+            Environment y(x, 1, data[1][lane]);
+            Environment z(y, 2, data[2][lane]);
+            std::string want = outcomeOf([&] { return std::to_string(scalar.evaluate(*root, z)); });
+
+            std::string got;
+            if (results.failed(lane)) {
+                auto it = std::find_if(results.errors.begin(), results.errors.end(),
+                    [&](const std::pair<size_t, std::string>& e) { return e.first == lane; });
+                got = "error: " + it->second;
+                failedHere++;
+            }
+            else {
+                got = std::to_string(results.values[lane]);
+            }
+            lanesChecked++;
+            if (got != want && failures++ < 10) {
+                std::fprintf(stderr, "tree %d lane %zu (%d, %d, %d): lanes %s, scalar %s\n", t, lane,
+                    data[0][lane], data[1][lane], data[2][lane], got.c_str(), want.c_str());
+            }
+        }
+        lanesFailed += static_cast<long>(failedHere);
+        if (failedHere != 0 && failedHere != lanes) {
+            mixedTrees++;
+        }
+    }
+
+    if (failures != 0) {
+        std::fprintf(stderr, "glyph-bench: %d lane mismatches\n", failures);
+        return 1;
+    }
+    if (mixedTrees == 0) {
+        std::fprintf(stderr, "glyph-bench: no tree had both failing and succeeding lanes\n");
+        return 1;
+    }
+    std::printf("lane check (%s): %ld lanes over %d trees (%ld failed, %d trees mixed), all match the scalar evaluator\n",
+        laneKernelName(), lanesChecked, TREES, lanesFailed, mixedTrees);
+    return 0;
+}
+
+// A random program with up to three random bytes spliced in (sometimes one
+// outside the alphabet) and now and then truncated or extended, so most
+// kinds of syntax error and evaluation error show up
+static std::string mutatedProgram(std::mt19937& rng) {
+    std::string s = randomProgram(rng, 2 + rng() % 10);
+    for (int n = rng() % 2 == 0 ? 0 : 1 + rng() % 3; n > 0; n--) {
+        size_t at = rng() % (s.size() + 1);
+        char c = rng() % 20 == 0 ? 'x' : "()+-*^%_:"[rng() % 9];
+        if (rng() % 2 == 0 && at < s.size()) {
+            s[at] = c;
+        }
+        else {
+            s.insert(s.begin() + at, c);
+        }
+    }
+    switch (rng() % 8) {
+    case 0: s.resize(rng() % (s.size() + 1)); break;
+    case 1: s += randomProgram(rng, 2); break;
+    default: break;
+    }
+    return s;
+}
+
+// Hands out its text in chunks of random sizes, so a stream reader sees
+// every possible split
+class ChunkedBuffer : public std::streambuf {
+private:
+    std::string text;
+    size_t pos = 0;
+    std::mt19937& rng;
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (pos == text.size()) {
+            return traits_type::eof();
+        }
+        size_t n = std::min<size_t>(1 + rng() % 16, text.size() - pos);
+        char* begin = &text[pos];
+        setg(begin, begin, begin + n);
+        pos += n;
+        return traits_type::to_int_type(*begin);
+    }
+
+public:
+    ChunkedBuffer(std::string source, std::mt19937& random) : text(std::move(source)), rng(random) {}
+};
+
+// Runs mutated programs through the streaming evaluator four ways: fed
+// directly in random chunks, through run(std::istream&) over a stream that
+// delivers random chunks, through runAs(std::istream&) with bigint, and
+// through tryRun(). Each outcome must match run() or runAs() on the whole
+// text.
+static int checkStreaming() {
+    constexpr int PROGRAMS = 20000;
+    std::mt19937 rng(23);
+    GlyphInterpreter interpreter;
+    StreamEvaluator stream;
+
+    long failed = 0;
+    int failures = 0;
+    auto expect = [&](const std::string& program, const char* path, const std::string& got, const std::string& want) {
+        if (got != want && failures++ < 10) {
+            std::fprintf(stderr, "[%.60s] %s: %s, run() %s\n", program.c_str(), path, got.c_str(), want.c_str());
+        }
+    };
+
+    for (int p = 0; p < PROGRAMS; p++) {
+        std::string program = mutatedProgram(rng);
+        std::string want = outcomeOf([&] { return std::to_string(interpreter.run(program)); });
+        if (want.compare(0, 7, "error: ") == 0) {
+            failed++;
+        }
+
+        std::string fed = outcomeOf([&] {
+            stream.reset();
+            for (size_t at = 0; at < program.size();) {
+                size_t n = std::min<size_t>(rng() % 8, program.size() - at);
+                stream.feed(std::string_view(program).substr(at, n));
+                at += n;
+            }
+            return std::to_string(stream.finish());
+        });
+        expect(program, "feed()", fed, want);
+
+        RunResult tried = interpreter.tryRun(program);
+        expect(program, "tryRun()", tried ? std::to_string(tried.value()) : "error: " + tried.message(), want);
+
+        std::string read = outcomeOf([&] {
+            ChunkedBuffer buffer(program, rng);
+            std::istream in(&buffer);
+            return std::to_string(interpreter.run(in));
+        });
+        expect(program, "run(istream)", read, want);
+
+        std::string wide = outcomeOf([&] {
+            ChunkedBuffer buffer(program, rng);
+            std::istream in(&buffer);
+            return interpreter.runAs(in, NumericBackend::BIGINT);
+        });
+        expect(program, "runAs(istream, bigint)", wide,
+            outcomeOf([&] { return interpreter.runAs(program, NumericBackend::BIGINT); }));
+    }
+
+    if (failures != 0) {
+        std::fprintf(stderr, "glyph-bench: %d streaming mismatches\n", failures);
+        return 1;
+    }
+    std::printf("streaming check: %d programs (%ld failing), all match run()\n", PROGRAMS, failed);
+    return 0;
+}
+
+// Runs random programs with every binary node forked (a grain of one node) on
+// three workers, under run() and runAs() with each backend, and compares
+// each value or error with a sequential run. The optimizer is off for both,
+// so the trees are not folded away before they are forked.
+static int checkParallel() {
+    constexpr int PROGRAMS = 3000;
+    std::mt19937 rng(28);
+    GlyphInterpreter sequential;
+    sequential.setOptimize(false);
+    GlyphInterpreter parallel;
+    parallel.setOptimize(false);
+    parallel.setParallel(3, 1);
+
+    long failed = 0;
+    int failures = 0;
+    auto compare = [&](const std::string& program, const char* backend, const std::function<std::string(GlyphInterpreter&)>& run) {
+        std::string want = outcomeOf([&] { return run(sequential); });
+        std::string got = outcomeOf([&] { return run(parallel); });
+        if (want.compare(0, 7, "error: ") == 0) {
+            failed++;
+        }
+        if (got != want && failures++ < 10) {
+            std::fprintf(stderr, "[%.60s] %s: %s, sequential %s\n", program.c_str(), backend, got.c_str(), want.c_str());
+        }
+    };
+
+    for (int p = 0; p < PROGRAMS; p++) {
+        std::string program = randomProgram(rng, 4 + rng() % 12);
+        compare(program, "run()", [&](GlyphInterpreter& interpreter) { return std::to_string(interpreter.run(program)); });
+        for (const char* name : { "int32", "int64", "checked-int64", "bigint" }) {
+            NumericBackend backend = NumericBackend::INT32;
+            parseNumericBackend(name, backend);
+            compare(program, name, [&](GlyphInterpreter& interpreter) { return interpreter.runAs(program, backend); });
+        }
+    }
+
+    if (failures != 0) {
+        std::fprintf(stderr, "glyph-bench: %d parallel mismatches\n", failures);
+        return 1;
+    }
+    std::printf("parallel check: %d programs x 5 entry points (%ld failing), all match a sequential run\n", PROGRAMS, failed);
+    return 0;
+}
+
+// Runs random programs under a step limit of exactly their estimated steps,
+// with each backend and under each configuration estimate() accounts for.
+// None may run out of steps; a program the analysis cannot bound is skipped.
+// A few fixed programs have conditions that are nonzero exactly but wrap to
+// zero in int32 or int64, which then take the costlier branch.
+static int checkCost() {
+    constexpr int PROGRAMS = 4000;
+    const char* const configurations[] = { "default", "unoptimized", "cache", "memo", "stats" };
+    std::mt19937 rng(29);
+
+    const std::string two16 = "(^(+__)(^(+__)(*(+__)(+__))))";
+    const std::string two32 = "(*" + two16 + two16 + ")";
+    const std::string two64 = "(*" + two32 + two32 + ")";
+    const std::string costly = "(+(+" + two32 + two32 + ")(+" + two32 + two32 + "))";
+    const std::string wrapping[] = { "(%" + two32 + "_" + costly + ")", "(%" + two64 + "_" + costly + ")" };
+
+    long runs = 0;
+    long failed = 0;
+    int failures = 0;
+    for (const char* configuration : configurations) {
+        GlyphInterpreter interpreter;
+        std::string name = configuration;
+        interpreter.setOptimize(name != "unoptimized");
+        interpreter.setCacheBudget(name == "cache" ? 1u << 20 : 0);
+        interpreter.setMemoize(name == "memo");
+        interpreter.setStats(name == "stats");
+
+        for (size_t p = 0; p < PROGRAMS + std::size(wrapping); p++) {
+            std::string program = p < std::size(wrapping) ? wrapping[p] : randomProgram(rng, 2 + rng() % 12);
+            CostEstimate estimate = interpreter.estimate(program);
+            for (const char* backendName : { "int32", "int64", "checked-int64", "bigint" }) {
+                NumericBackend backend = NumericBackend::INT32;
+                parseNumericBackend(backendName, backend);
+                uint64_t steps = estimate.steps(backend);
+                if (steps == CostEstimate::UNBOUNDED) {
+                    continue;
+                }
+                interpreter.setStepLimit(steps);
+                runs++;
+                try {
+                    interpreter.runAs(program, backend);
+                }
+                catch (const StepLimitExceeded&) {
+                    if (failures++ < 10) {
+                        std::fprintf(stderr, "[%.60s] %s, %s: ran out of %llu estimated steps\n", program.c_str(),
+                            configuration, backendName, static_cast<unsigned long long>(steps));
+                    }
+                }
+                catch (const std::runtime_error&) {
+                    failed++;
+                }
+            }
+        }
+    }
+
+    if (failures != 0) {
+        std::fprintf(stderr, "glyph-bench: %d runs exceeded their estimated steps\n", failures);
+        return 1;
+    }
+    std::printf("cost check: %ld runs (%ld failing), none exceeded their estimated steps\n", runs, failed);
+    return 0;
+}
+
+static const Workload* findWorkload(const std::string& name) {
+    for (const Workload& w : WORKLOADS) {
+        if (name == w.name) {
+            return &w;
+        }
+    }
+    return nullptr;
+}
+
+static int usage() {
+    std::fprintf(stderr, "Usage: glyph-bench [--warmup N] [--reps N] [--workload NAME[=PARAM]]... [--out FILE]\n");
+    std::fprintf(stderr, "       glyph-bench --check-allocations|--check-incremental|--check-lanes|--check-streaming|--check-parallel|--check-cost\n");
+    std::fprintf(stderr, "Workloads:");
+    for (const Workload& w : WORKLOADS) {
+        std::fprintf(stderr, " %s=%lld", w.name, w.defaultParam);
+    }
+    std::fprintf(stderr, "\n");
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    const char* outPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--warmup" && i + 1 < argc) {
+            opt.warmup = std::atoi(argv[++i]);
+        }
+        else if (arg == "--reps" && i + 1 < argc) {
+            opt.reps = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--check-allocations") {
+            return checkAllocations();
+        }
+        else if (arg == "--check-incremental") {
+            return checkIncremental();
+        }
+        else if (arg == "--check-lanes") {
+            return checkLanes();
+        }
+        else if (arg == "--check-streaming") {
+            return checkStreaming();
+        }
+        else if (arg == "--check-parallel") {
+            return checkParallel();
+        }
+        else if (arg == "--check-cost") {
+            return checkCost();
+        }
+        else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        }
+        else if (arg == "--workload" && i + 1 < argc) {
+            std::string spec = argv[++i];
+            size_t eq = spec.find('=');
+            const Workload* w = findWorkload(spec.substr(0, eq));
+            if (w == nullptr) {
+                return usage();
+            }
+            long long param = eq == std::string::npos ? w->defaultParam : std::atoll(spec.c_str() + eq + 1);
+            if (param < 1) {
+                return usage();
+            }
+            opt.selected.push_back({ w, param });
+        }
+        else {
+            return usage();
+        }
+    }
+    if (opt.selected.empty()) {
+        for (const Workload& w : WORKLOADS) {
+            opt.selected.push_back({ &w, w.defaultParam });
+        }
+    }
+
+    std::FILE* out = stdout;
+    if (outPath != nullptr) {
+        out = std::fopen(outPath, "w");
+        if (out == nullptr) {
+            std::fprintf(stderr, "Cannot open %s\n", outPath);
+            return 1;
+        }
+    }
+
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"scanner\": \"%s\",\n", sourceScannerName());
+    std::fprintf(out, "  \"warmup\": %d,\n", opt.warmup);
+    std::fprintf(out, "  \"repetitions\": %d,\n", opt.reps);
+    runPowKernel(out);
+    std::fprintf(out, "  \"workloads\": [\n");
+    for (size_t i = 0; i < opt.selected.size(); i++) {
+        runWorkload(out, opt, *opt.selected[i].first, opt.selected[i].second, i + 1 == opt.selected.size());
+    }
+    std::fprintf(out, "  ],\n");
+    std::fprintf(out, "  \"peak_rss_kb\": %lld\n", peakRssKb());
+    std::fprintf(out, "}\n");
+
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
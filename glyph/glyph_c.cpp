@@ -0,0 +1,159 @@
+#include "glyph_c.h"
+#include "glyph.h"
+#include <new>
+#include <string>
+
+// ============================================================================
+// C Interface
+// ============================================================================
+
+struct glyph_context {
+    GlyphInterpreter interpreter;
+    std::string error;  // last failure, reused across calls
+    std::string result; // last glyph_run_as value
+};
+
+struct glyph_program {
+    Bytecode bytecode;
+};
+
+// Runs body, turning any exception into a status and context->error
+template <typename Body>
+static glyph_status guarded(glyph_context* context, Body body) {
+    if (context == nullptr) {
+        return GLYPH_INVALID_ARGUMENT;
+    }
+    context->error.clear();
+    try {
+        body();
+        return GLYPH_OK;
+    }
+    catch (const StepLimitExceeded& e) {
+        context->error = e.what();
+        return GLYPH_STEP_LIMIT;
+    }
+    catch (const DeadlineExceeded& e) {
+        context->error = e.what();
+        return GLYPH_DEADLINE;
+    }
+    catch (const std::bad_alloc&) {
+        context->error = "Out of memory";
+        return GLYPH_ERROR;
+    }
+    catch (const std::exception& e) {
+        context->error = e.what();
+        return GLYPH_ERROR;
+    }
+    catch (...) {
+        context->error = "Unknown error";
+        return GLYPH_ERROR;
+    }
+}
+
+extern "C" {
+
+glyph_context* glyph_context_create(void) {
+    return new (std::nothrow) glyph_context();
+}
+
+void glyph_context_destroy(glyph_context* context) {
+    delete context;
+}
+
+void glyph_context_reset(glyph_context* context) {
+    if (context != nullptr) {
+        context->interpreter.reset();
+        context->error.clear();
+        context->result.clear();
+    }
+}
+
+void glyph_set_max_depth(glyph_context* context, size_t depth) {
+    if (context != nullptr) {
+        context->interpreter.setMaxDepth(depth);
+    }
+}
+
+void glyph_set_step_limit(glyph_context* context, unsigned long long steps) {
+    if (context != nullptr) {
+        context->interpreter.setStepLimit(steps);
+    }
+}
+
+void glyph_set_timeout(glyph_context* context, unsigned long long milliseconds) {
+    if (context != nullptr) {
+        context->interpreter.setTimeout(std::chrono::milliseconds(milliseconds));
+    }
+}
+
+void glyph_set_jit(glyph_context* context, unsigned int threshold) {
+    if (context != nullptr) {
+        context->interpreter.setJitThreshold(threshold);
+    }
+}
+
+void glyph_set_cache(glyph_context* context, size_t bytes) {
+    if (context != nullptr) {
+        context->interpreter.setCacheBudget(bytes);
+        context->interpreter.setResultCache(bytes != 0);
+    }
+}
+
+void glyph_set_parallel(glyph_context* context, size_t threads) {
+    if (context != nullptr) {
+        context->interpreter.setParallel(threads);
+    }
+}
+
+glyph_status glyph_parse(glyph_context* context, const char* source, size_t length, glyph_program** program) {
+    if (source == nullptr || program == nullptr) {
+        return GLYPH_INVALID_ARGUMENT;
+    }
+    *program = nullptr;
+    return guarded(context, [&] {
+        auto compiled = std::make_unique<glyph_program>();
+        compiled->bytecode = context->interpreter.compile(std::string_view(source, length));
+        *program = compiled.release();
+    });
+}
+
+void glyph_program_destroy(glyph_program* program) {
+    delete program;
+}
+
+glyph_status glyph_eval(glyph_context* context, const glyph_program* program, int* result) {
+    if (program == nullptr || result == nullptr) {
+        return GLYPH_INVALID_ARGUMENT;
+    }
+    return guarded(context, [&] {
+        *result = context->interpreter.execute(program->bytecode);
+    });
+}
+
+glyph_status glyph_run(glyph_context* context, const char* source, size_t length, int* result) {
+    if (source == nullptr || result == nullptr) {
+        return GLYPH_INVALID_ARGUMENT;
+    }
+    return guarded(context, [&] {
+        *result = context->interpreter.run(std::string_view(source, length));
+    });
+}
+
+glyph_status glyph_run_as(glyph_context* context, const char* source, size_t length,
+    const char* backend, const char** result) {
+    NumericBackend numeric;
+    if (source == nullptr || backend == nullptr || result == nullptr || !parseNumericBackend(backend, numeric)) {
+        return GLYPH_INVALID_ARGUMENT;
+    }
+    *result = "";
+    return guarded(context, [&] {
+        context->result = context->interpreter.runAs(std::string_view(source, length), numeric);
+        *result = context->result.c_str();
+    });
+}
+
+const char* glyph_last_error(const glyph_context* context) {
+    return context != nullptr ? context->error.c_str() : "";
+}
+
+}
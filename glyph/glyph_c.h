@@ -0,0 +1,98 @@
+#pragma once
+
+/*
+ * C interface to the Glyph interpreter, built into libglyph (static and
+ * shared). A context owns the interpreter settings, its program cache and
+ * the text of the last error or result; use one context per thread.
+ * Programs are parsed and compiled once and can then be evaluated any number
+ * of times without allocating.
+ *
+ * Every function that can fail returns a glyph_status; on failure the
+ * message is available from glyph_last_error until the next call on the
+ * same context. No exception ever crosses this interface.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(GLYPH_BUILD_SHARED)
+#define GLYPH_API __declspec(dllexport)
+#elif defined(GLYPH_USE_SHARED)
+#define GLYPH_API __declspec(dllimport)
+#else
+#define GLYPH_API
+#endif
+#else
+#define GLYPH_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct glyph_context glyph_context;
+typedef struct glyph_program glyph_program;
+
+typedef enum glyph_status {
+    GLYPH_OK = 0,
+    GLYPH_ERROR = 1,          /* invalid program or evaluation error */
+    GLYPH_STEP_LIMIT = 2,     /* glyph_set_step_limit exceeded */
+    GLYPH_DEADLINE = 3,       /* glyph_set_timeout exceeded */
+    GLYPH_INVALID_ARGUMENT = 4
+} glyph_status;
+
+/* NULL if memory is exhausted */
+GLYPH_API glyph_context* glyph_context_create(void);
+GLYPH_API void glyph_context_destroy(glyph_context* context);
+
+/* Drops cached programs and counters; settings and warm buffers are kept */
+GLYPH_API void glyph_context_reset(glyph_context* context);
+
+/* Maximum expression nesting (0 = no limit; default 1000000) */
+GLYPH_API void glyph_set_max_depth(glyph_context* context, size_t depth);
+
+/* Evaluation steps and wall time allowed per program (0 = no limit) */
+GLYPH_API void glyph_set_step_limit(glyph_context* context, unsigned long long steps);
+GLYPH_API void glyph_set_timeout(glyph_context* context, unsigned long long milliseconds);
+
+/*
+ * Evaluations of one parsed program before it is compiled to machine code
+ * (0 = never; default 1000). Only on x86-64 and with no step or time limit.
+ */
+GLYPH_API void glyph_set_jit(glyph_context* context, unsigned int threshold);
+
+/* Program cache budget for glyph_run / glyph_run_as in bytes (0 = off) */
+GLYPH_API void glyph_set_cache(glyph_context* context, size_t bytes);
+
+/*
+ * Worker threads that evaluate large subtrees of one program in parallel
+ * (0 = off, the default). Used by glyph_run and glyph_run_as while no step
+ * or time limit and no cache is set; never by glyph_eval.
+ */
+GLYPH_API void glyph_set_parallel(glyph_context* context, size_t threads);
+
+/* Validates, parses and compiles source[0, length) into *program */
+GLYPH_API glyph_status glyph_parse(glyph_context* context, const char* source, size_t length,
+    glyph_program** program);
+GLYPH_API void glyph_program_destroy(glyph_program* program);
+
+/* Evaluates a parsed program with int32 arithmetic */
+GLYPH_API glyph_status glyph_eval(glyph_context* context, const glyph_program* program, int* result);
+
+/* Parses and evaluates in one call with int32 arithmetic */
+GLYPH_API glyph_status glyph_run(glyph_context* context, const char* source, size_t length, int* result);
+
+/*
+ * Parses and evaluates with the named backend ("int32", "int64",
+ * "checked-int64" or "bigint"). *result points at the decimal value, owned
+ * by the context and valid until its next call.
+ */
+GLYPH_API glyph_status glyph_run_as(glyph_context* context, const char* source, size_t length,
+    const char* backend, const char** result);
+
+/* Message of the last failure on this context ("" if none) */
+GLYPH_API const char* glyph_last_error(const glyph_context* context);
+
+#ifdef __cplusplus
+}
+#endif